@@ -0,0 +1,193 @@
+//
+//  Catalog.cpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#include "Catalog.hpp"
+#include "Logger.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sstream>
+#include <algorithm>
+
+namespace cc {
+    
+    // ----------------------------------------------------------------------
+    Catalog::~Catalog() {
+        close();
+    }
+    
+    // ----------------------------------------------------------------------
+    std::string Catalog::defaultPath(const std::string& dir) {
+        return (dir.empty() ? "." : dir) + "/" + CATALOG_NAME;
+    }
+    
+    // ----------------------------------------------------------------------
+    void Catalog::copy(char* dst, const std::string& src, size_t size) {
+        size_t n = std::min(src.size(), size-1);
+        memcpy(dst, src.data(), n);
+        dst[n] = 0;
+    }
+    
+    // ----------------------------------------------------------------------
+    void Catalog::open(const std::string& path) {
+        close();
+        
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if(fd < 0) {
+            Logger::getInstance()->warning("can't open catalog "+path+": "+strerror(errno));
+            return;
+        }
+        
+        // Whoever creates the file writes the header, under the lock
+        flock(fd, LOCK_EX);
+        struct stat st;
+        bool ok = fstat(fd, &st) == 0;
+        if(ok && st.st_size < CATALOG_HEADER_SIZE) {
+            ok = ftruncate(fd, CATALOG_HEADER_SIZE + CATALOG_GROW * sizeof(CatalogRecord)) == 0;
+            st.st_size = CATALOG_HEADER_SIZE + CATALOG_GROW * sizeof(CatalogRecord);
+        }
+        ok = ok && remap(st.st_size);
+        if(ok && header()->magic == 0) {
+            header()->version = CATALOG_VERSION;
+            header()->recordSize = sizeof(CatalogRecord);
+            header()->count = 0;
+            __atomic_store_n(&header()->magic, CATALOG_MAGIC, __ATOMIC_RELEASE);
+        }
+        flock(fd, LOCK_UN);
+        
+        if(!ok || header()->magic != CATALOG_MAGIC || header()->version != CATALOG_VERSION || header()->recordSize != sizeof(CatalogRecord)) {
+            Logger::getInstance()->warning("can't use catalog "+path+(ok ? ": wrong format" : std::string(": ")+strerror(errno)));
+            close();
+            return;
+        }
+        
+        refresh();
+        std::stringstream ss;
+        ss << "catalog " << path << " has " << indexed << " captures";
+        Logger::getInstance()->status(ss.str());
+    }
+    
+    // ----------------------------------------------------------------------
+    void Catalog::close() {
+        if(map) munmap(map, mapSize);
+        if(fd >= 0) ::close(fd);
+        map = NULL;
+        mapSize = 0;
+        fd = -1;
+    }
+    
+    // ----------------------------------------------------------------------
+    // The old mapping stays if the new one can't be made
+    bool Catalog::remap(size_t size) {
+        void* m = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(m == MAP_FAILED) return false;
+        if(map) munmap(map, mapSize);
+        map = m;
+        mapSize = size;
+        return true;
+    }
+    
+    // ----------------------------------------------------------------------
+    uint64_t Catalog::count() {
+        if(!map) return memory.size();
+        return __atomic_load_n(&header()->count, __ATOMIC_ACQUIRE);
+    }
+    
+    // ----------------------------------------------------------------------
+    const CatalogRecord& Catalog::at(uint64_t i) {
+        if(!map) return memory[i];
+        return ((const CatalogRecord*)((char*)map + CATALOG_HEADER_SIZE))[i];
+    }
+    
+    // ----------------------------------------------------------------------
+    void Catalog::append(const CatalogRecord& record) {
+        if(!map) {
+            memory.push_back(record);
+            memory.back().committed = CATALOG_MAGIC;
+            refresh();
+            return;
+        }
+        
+        flock(fd, LOCK_EX);
+        uint64_t n = header()->count;
+        size_t needed = CATALOG_HEADER_SIZE + (n+1) * sizeof(CatalogRecord);
+        
+        // Another process may have grown the file already
+        struct stat st;
+        if(fstat(fd, &st) == 0 && (size_t)st.st_size > mapSize) remap(st.st_size);
+        if(map && needed > mapSize) {
+            size_t grown = mapSize + CATALOG_GROW * sizeof(CatalogRecord);
+            if(ftruncate(fd, grown) < 0 || !remap(grown)) {
+                Logger::getInstance()->warning(std::string("can't grow catalog: ")+strerror(errno));
+            }
+        }
+        if(!map || needed > mapSize) {
+            flock(fd, LOCK_UN);
+            Logger::getInstance()->warning("catalog is full. "+std::string(record.path)+" isn't in it");
+            return;
+        }
+        
+        CatalogRecord* slot = (CatalogRecord*)((char*)map + CATALOG_HEADER_SIZE) + n;
+        *slot = record;
+        slot->committed = CATALOG_MAGIC;
+        __atomic_store_n(&header()->count, n+1, __ATOMIC_RELEASE);
+        flock(fd, LOCK_UN);
+        
+        refresh();
+    }
+    
+    // ----------------------------------------------------------------------
+    void Catalog::refresh() {
+        uint64_t n = count();
+        if(n == indexed) return;
+        if(map && CATALOG_HEADER_SIZE + n * sizeof(CatalogRecord) > mapSize) {
+            struct stat st;
+            if(fstat(fd, &st) < 0 || !remap(st.st_size)) {
+                Logger::getInstance()->warning(std::string("can't remap catalog: ")+strerror(errno));
+                return;
+            }
+        }
+        for(; indexed < n; indexed++) {
+            const CatalogRecord& r = at(indexed);
+            if(r.committed != CATALOG_MAGIC) continue;
+            byTime.insert(std::make_pair(r.started, indexed));
+            byCamera[std::string(r.serial, strnlen(r.serial, sizeof(r.serial)))].insert(std::make_pair(r.started, indexed));
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    std::vector<CatalogRecord> Catalog::query(const CatalogQuery& q) {
+        refresh();
+        std::vector<CatalogRecord> results;
+        
+        const std::multimap<int64_t, uint64_t>* index = &byTime;
+        if(!q.serial.empty()) {
+            auto it = byCamera.find(q.serial);
+            if(it == byCamera.end()) return results;
+            index = &it->second;
+        }
+        
+        auto first = index->lower_bound(q.since);
+        auto last = index->upper_bound(q.until);
+        if(q.limit == 0) {
+            for(auto it = first; it != last; ++it) results.push_back(at(it->second));
+        } else {
+            // The newest ones, still returned oldest first
+            for(auto it = last; it != first && results.size() < q.limit; ) {
+                --it;
+                results.push_back(at(it->second));
+            }
+            std::reverse(results.begin(), results.end());
+        }
+        return results;
+    }
+}
@@ -0,0 +1,95 @@
+//
+//  Catalog.hpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <stdint.h>
+
+#define CATALOG_MAGIC 0x434e4143    // "CANC"
+#define CATALOG_VERSION 1
+#define CATALOG_HEADER_SIZE 4096
+#define CATALOG_GROW 4096           // records added each time the file fills up
+#define CATALOG_NAME ".canon-cli.catalog"
+
+namespace cc {
+    
+    // One finalized download. Fixed size, so record i is at a known offset
+    struct CatalogRecord {
+        uint32_t committed;     // CATALOG_MAGIC once the record is whole
+        uint32_t format;        // EDSDK object format
+        uint64_t size;
+        uint64_t hash;          // XXH64 of the file
+        uint64_t seq;
+        int64_t started;        // epoch ms. Equal to stopped for stills
+        int64_t stopped;
+        int64_t finalized;
+        char serial[32];
+        char id[64];            // the request's "@id", if it had one
+        char path[392];
+    };
+    
+    struct CatalogQuery {
+        int64_t since = 0;              // epoch ms, inclusive
+        int64_t until = INT64_MAX;      // epoch ms, inclusive
+        std::string serial;             // empty for every camera
+        size_t limit = 0;               // newest first when set, 0 for all
+    };
+    
+    //
+    //  Every download this machine has made, in an append-only file next to
+    //  them. The file is mapped, so the daemons for several cameras can share
+    //  one: appends take an flock, and each process indexes records it hasn't
+    //  seen yet before answering a query. Queries never touch the folder.
+    //
+    class Catalog {
+        
+    private:
+        struct Header {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t recordSize;
+            uint32_t reserved;
+            uint64_t count;     // published after the record is written
+        };
+        
+        int fd = -1;
+        void* map = NULL;
+        size_t mapSize = 0;
+        std::vector<CatalogRecord> memory;     // when there's no file
+        
+        uint64_t indexed = 0;
+        std::multimap<int64_t, uint64_t> byTime;
+        std::map<std::string, std::multimap<int64_t, uint64_t>> byCamera;
+        
+        Header* header() { return (Header*)map; }
+        uint64_t count();
+        const CatalogRecord& at(uint64_t i);
+        bool remap(size_t size);
+        
+    public:
+        ~Catalog();
+        
+        static std::string defaultPath(const std::string& dir);
+        
+        // Failure is logged; the catalog then lives in memory for this run
+        void open(const std::string& path);
+        void close();
+        
+        void append(const CatalogRecord& record);
+        
+        // Pick up what other processes have appended
+        void refresh();
+        
+        std::vector<CatalogRecord> query(const CatalogQuery& q);
+        size_t size() { return (size_t)indexed; }
+        
+        static void copy(char* dst, const std::string& src, size_t size);
+    };
+}
@@ -0,0 +1,111 @@
+//
+//  ControlClient.cpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#include "ControlClient.hpp"
+#include "ControlServer.hpp"
+#include "json.hpp"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+using json = nlohmann::json;
+
+namespace cc {
+    
+    // ----------------------------------------------------------------------
+    int ControlClient::run(int argc, char* argv[]) {
+        Logger* log = Logger::getInstance();
+        
+        EdsInt32 cameraIndex = 0;
+        std::string path;
+        int timeout = 0;
+        
+        int i = 1;
+        for(; i < argc && argv[i][0] == '-'; ++i) {
+            std::string opt = argv[i];
+            if(i+1 >= argc) break;
+            if(opt.compare("-i")==0 || opt.compare("--id")==0) cameraIndex = atoi(argv[++i]);
+            else if(opt.compare("-u")==0 || opt.compare("--socket")==0) path = argv[++i];
+            else if(opt.compare("-t")==0 || opt.compare("--timeout")==0) timeout = atoi(argv[++i]);
+            else break;
+        }
+        
+        std::stringstream line;
+        line << "@ctl-" << getpid();
+        for(; i < argc; ++i) line << " " << argv[i];
+        command cmd = Session::parseCommand(line.str());
+        if(cmd.size() < 2) {
+            std::cerr << "usage: " << argv[0] << " [-i id] [-u socket] [-t timeout] <command> [args...]" << std::endl;
+            return 1;
+        }
+        
+        if(path.empty()) path = ControlServer::defaultPath(cameraIndex);
+        
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path)-1);
+        
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+            log->error("can't connect to "+path+" ("+strerror(errno)+"). is canon-cli --daemon running?");
+            return 1;
+        }
+        if(timeout > 0) {
+            struct timeval tv = {timeout, 0};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        }
+        
+        std::string out = line.str() + "\n";
+        if(write(fd, out.data(), out.size()) != (ssize_t)out.size()) {
+            log->error(std::string("write: ")+strerror(errno));
+            close(fd);
+            return 1;
+        }
+        
+        // Print events until the one marked done
+        int status = 0;
+        bool done = false;
+        std::string buffer;
+        char chunk[4096];
+        while(!done) {
+            ssize_t n = read(fd, chunk, sizeof(chunk));
+            if(n <= 0) {
+                log->error(n < 0 && errno == EAGAIN ? "timed out" : "daemon closed the connection");
+                status = 2;
+                break;
+            }
+            buffer.append(chunk, n);
+            
+            size_t pos;
+            while(!done && (pos = buffer.find('\n')) != std::string::npos) {
+                std::string event = buffer.substr(0, pos);
+                buffer.erase(0, pos+1);
+                
+                // Anything that isn't an event means we can't tell how the command went
+                json j;
+                try {
+                    j = json::parse(event);
+                } catch(const json::parse_error& e) {
+                    std::cerr << event << std::endl;
+                    log->error(std::string("bad event from the daemon: ")+e.what());
+                    close(fd);
+                    return 2;
+                }
+                std::cout << event << std::endl;
+                if(j["event"] == "error" || (j["event"] == "result" && j["status"] != "ok")) status = 1;
+                if(j.count("done")) done = true;
+            }
+        }
+        
+        close(fd);
+        return status;
+    }
+}
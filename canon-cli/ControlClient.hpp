@@ -0,0 +1,26 @@
+//
+//  ControlClient.hpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#pragma once
+
+#include <string>
+
+namespace cc {
+    
+    //
+    //  Thin client for a daemon started with --daemon:
+    //
+    //    canon-cli ctl [-i id] [-u socket] [-t timeout] <command> [args...]
+    //
+    //  Sends one command over the control socket, prints its events as JSON lines
+    //  and exits once the last one arrives. Never touches the SDK.
+    //
+    class ControlClient {
+    public:
+        static int run(int argc, char* argv[]);
+    };
+}
@@ -0,0 +1,343 @@
+//
+//  ControlServer.cpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#include "ControlServer.hpp"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <sstream>
+
+#ifdef __APPLE__
+#include <sys/event.h>
+#else
+#include <sys/epoll.h>
+#endif
+
+#ifdef MSG_NOSIGNAL
+#define CONTROL_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define CONTROL_SEND_FLAGS 0
+#endif
+
+#define CONTROL_MAX_EVENTS 64
+
+namespace cc {
+    
+    static void setNonBlocking(int fd) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    
+    // ----------------------------------------------------------------------
+    ControlServer::ControlServer(Session* session, std::string path) :
+    session(session),
+    path(path),
+    running(false) {
+        
+    }
+    
+    // ----------------------------------------------------------------------
+    std::string ControlServer::defaultPath(EdsInt32 cameraIndex) {
+        std::stringstream ss;
+        ss << "/tmp/canon-cli-" << cameraIndex << ".sock";
+        return ss.str();
+    }
+    
+    // ----------------------------------------------------------------------
+    ControlServer::~ControlServer() {
+        stop();
+    }
+    
+    // ----------------------------------------------------------------------
+    void ControlServer::start() {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if(path.size() >= sizeof(addr.sun_path))
+            throw std::runtime_error("socket path too long: "+path);
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path)-1);
+        
+        // A socket nobody answers on is left over from a crashed run. One that
+        // answers belongs to a daemon that's still running; don't take it away
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(probe < 0)
+            throw std::runtime_error(std::string("socket: ")+strerror(errno));
+        int connected = connect(probe, (struct sockaddr*)&addr, sizeof(addr));
+        int error = errno;
+        close(probe);
+        if(connected == 0)
+            throw std::runtime_error(path+" is in use: already running");
+        if(error == ECONNREFUSED) {
+            unlink(path.c_str());
+        } else if(error != ENOENT) {
+            throw std::runtime_error("connect "+path+": "+strerror(error));
+        }
+        
+        listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(listenFd < 0)
+            throw std::runtime_error(std::string("socket: ")+strerror(errno));
+        
+        if(bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+            throw std::runtime_error("bind "+path+": "+strerror(errno));
+        if(listen(listenFd, 64) < 0)
+            throw std::runtime_error(std::string("listen: ")+strerror(errno));
+        setNonBlocking(listenFd);
+        
+        if(pipe(wakeFds) < 0)
+            throw std::runtime_error(std::string("pipe: ")+strerror(errno));
+        setNonBlocking(wakeFds[0]);
+        setNonBlocking(wakeFds[1]);
+        
+#ifdef __APPLE__
+        pollFd = kqueue();
+#else
+        pollFd = epoll_create1(EPOLL_CLOEXEC);
+#endif
+        if(pollFd < 0)
+            throw std::runtime_error(std::string("poll: ")+strerror(errno));
+        
+        watch(listenFd, false);
+        watch(wakeFds[0], false);
+        
+        Logger::getInstance()->status("listening on "+path);
+        running = true;
+        thread = std::thread(&ControlServer::run, this);
+    }
+    
+    // ----------------------------------------------------------------------
+    void ControlServer::stop() {
+        if(running) {
+            running = false;
+            char c = 0;
+            write(wakeFds[1], &c, 1);
+            thread.join();
+        }
+        
+        for(auto& it : clients) close(it.second.fd);
+        clients.clear();
+        clientsByFd.clear();
+        
+        if(listenFd >= 0) {
+            close(listenFd);
+            unlink(path.c_str());
+        }
+        if(pollFd >= 0) close(pollFd);
+        if(wakeFds[0] >= 0) close(wakeFds[0]);
+        if(wakeFds[1] >= 0) close(wakeFds[1]);
+        listenFd = pollFd = wakeFds[0] = wakeFds[1] = -1;
+    }
+    
+    // ----------------------------------------------------------------------
+    void ControlServer::send(uint64_t client, const std::string& line) {
+        outboxMutex.lock();
+        outbox.push_back(std::make_pair(client, line));
+        outboxMutex.unlock();
+        
+        char c = 0;
+        write(wakeFds[1], &c, 1);
+    }
+    
+    // ----------------------------------------------------------------------
+    // Register fd for read events, and write events while it has pending output.
+    void ControlServer::watch(int fd, bool wantWrite) {
+#ifdef __APPLE__
+        struct kevent changes[2];
+        EV_SET(&changes[0], fd, EVFILT_READ, EV_ADD, 0, 0, NULL);
+        EV_SET(&changes[1], fd, EVFILT_WRITE, wantWrite ? EV_ADD : EV_DELETE, 0, 0, NULL);
+        kevent(pollFd, changes, 2, NULL, 0, NULL); // EV_DELETE of an absent filter fails harmlessly
+#else
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        if(wantWrite) ev.events |= EPOLLOUT;
+        ev.data.fd = fd;
+        if(epoll_ctl(pollFd, EPOLL_CTL_MOD, fd, &ev) < 0 && errno == ENOENT)
+            epoll_ctl(pollFd, EPOLL_CTL_ADD, fd, &ev);
+#endif
+    }
+    
+    // ----------------------------------------------------------------------
+    void ControlServer::run() {
+        while(running) {
+            int ready[CONTROL_MAX_EVENTS];
+            bool canRead[CONTROL_MAX_EVENTS];
+            bool canWrite[CONTROL_MAX_EVENTS];
+            
+#ifdef __APPLE__
+            struct kevent events[CONTROL_MAX_EVENTS];
+            struct timespec timeout = {1, 0};
+            int n = kevent(pollFd, NULL, 0, events, CONTROL_MAX_EVENTS, &timeout);
+            for(int i=0; i<n; ++i) {
+                ready[i] = (int)events[i].ident;
+                canRead[i] = events[i].filter == EVFILT_READ;
+                canWrite[i] = events[i].filter == EVFILT_WRITE;
+            }
+#else
+            struct epoll_event events[CONTROL_MAX_EVENTS];
+            int n = epoll_wait(pollFd, events, CONTROL_MAX_EVENTS, 1000);
+            for(int i=0; i<n; ++i) {
+                ready[i] = events[i].data.fd;
+                canRead[i] = (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0;
+                canWrite[i] = (events[i].events & EPOLLOUT) != 0;
+            }
+#endif
+            if(n < 0 && errno != EINTR) {
+                Logger::getInstance()->error(std::string("control server: ")+strerror(errno));
+                break;
+            }
+            
+            for(int i=0; i<n; ++i) {
+                int fd = ready[i];
+                if(fd == listenFd) {
+                    acceptClients();
+                } else if(fd == wakeFds[0]) {
+                    char buf[256];
+                    while(read(wakeFds[0], buf, sizeof(buf)) > 0);
+                    drainOutbox();
+                } else {
+                    auto it = clientsByFd.find(fd);
+                    if(it == clientsByFd.end()) continue;
+                    uint64_t id = it->second;
+                    if(canWrite[i]) writeClient(id);
+                    if(canRead[i] && clients.count(id)) readClient(id);
+                }
+            }
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    void ControlServer::acceptClients() {
+        while(true) {
+            int fd = accept(listenFd, NULL, NULL);
+            if(fd < 0) return;
+            setNonBlocking(fd);
+#ifdef SO_NOSIGPIPE
+            int one = 1;
+            setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+            uint64_t id = nextClientId++;
+            Client& client = clients[id];
+            client.fd = fd;
+            client.connected = std::make_shared<std::atomic<bool>>(true);
+            clientsByFd[fd] = id;
+            watch(fd, false);
+            
+            std::stringstream ss;
+            ss << "control client " << id << " connected";
+            Logger::getInstance()->status(ss.str());
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    void ControlServer::readClient(uint64_t id) {
+        Client& client = clients[id];
+        char buf[4096];
+        bool eof = false;
+        while(true) {
+            ssize_t n = read(client.fd, buf, sizeof(buf));
+            if(n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                closeClient(id);
+                return;
+            }
+            if(n == 0) {
+                // "echo picture | nc -U" closes straight after writing, so
+                // what it sent still runs; the replies just have nowhere to go
+                if(client.in.size() && client.in.back() != '\n') client.in += '\n';
+                eof = true;
+                break;
+            }
+            if(n < 0) break;
+            client.in.append(buf, n);
+        }
+        
+        size_t pos;
+        while((pos = client.in.find('\n')) != std::string::npos) {
+            std::string line = client.in.substr(0, pos);
+            client.in.erase(0, pos+1);
+            
+            command cmd = Session::parseCommand(line);
+            if(cmd.empty()) continue;
+            if(cmd[0].compare("exit")==0) {
+                closeClient(id);
+                return;
+            }
+            session->addCommand(cmd, [this, id](const std::string& reply) {
+                send(id, reply);
+            }, client.connected);
+        }
+        
+        if(eof) {
+            closeClient(id);
+        } else if(client.in.size() > CONTROL_MAX_LINE) {
+            Logger::getInstance()->warning("control client sent an overlong line", LOG_SITE);
+            closeClient(id);
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    void ControlServer::writeClient(uint64_t id) {
+        Client& client = clients[id];
+        while(client.out.size()) {
+            ssize_t n = ::send(client.fd, client.out.data(), client.out.size(), CONTROL_SEND_FLAGS);
+            if(n < 0) {
+                if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+                if(errno == EINTR) continue;
+                closeClient(id);
+                return;
+            }
+            client.out.erase(0, n);
+        }
+        
+        bool writable = client.out.empty();
+        if(writable != client.writable) {
+            client.writable = writable;
+            watch(client.fd, !writable);
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    void ControlServer::closeClient(uint64_t id) {
+        auto it = clients.find(id);
+        if(it == clients.end()) return;
+        
+        *it->second.connected = false;
+        close(it->second.fd); // also removes it from the poll set
+        clientsByFd.erase(it->second.fd);
+        clients.erase(it);
+        
+        std::stringstream ss;
+        ss << "control client " << id << " disconnected";
+        Logger::getInstance()->status(ss.str());
+    }
+    
+    // ----------------------------------------------------------------------
+    void ControlServer::drainOutbox() {
+        std::vector<std::pair<uint64_t, std::string>> pending;
+        outboxMutex.lock();
+        pending.swap(outbox);
+        outboxMutex.unlock();
+        
+        for(auto& msg : pending) {
+            auto it = clients.find(msg.first);
+            if(it == clients.end()) continue;
+            
+            Client& client = it->second;
+            if(client.out.size() + msg.second.size() > CONTROL_MAX_PENDING) {
+                Logger::getInstance()->warning("control client is not reading its replies. disconnecting", LOG_SITE);
+                closeClient(msg.first);
+                continue;
+            }
+            client.out.append(msg.second);
+            client.out.push_back('\n');
+            writeClient(msg.first);
+        }
+    }
+}
@@ -0,0 +1,78 @@
+//
+//  ControlServer.hpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include "Session.hpp"
+
+#define CONTROL_MAX_LINE 4096
+#define CONTROL_MAX_PENDING (1024*1024)
+
+namespace cc {
+    
+    //
+    //  Accepts any number of clients on a Unix domain socket. Each client sends
+    //  newline terminated commands (same syntax as stdin, optionally prefixed with
+    //  "@<id>") and gets JSON event lines back for them. All socket I/O happens on a single thread driven by
+    //  epoll (kqueue on macOS); commands are parsed there and queued to the session.
+    //
+    class ControlServer {
+        
+    private:
+        struct Client {
+            int fd;
+            std::string in;
+            std::string out;
+            bool writable = true;  // false while waiting for the socket to drain
+            connection connected;  // shared with the client's requests
+        };
+        
+        Session* session;
+        std::string path;
+        int listenFd = -1;
+        int pollFd = -1;
+        int wakeFds[2] = {-1, -1};
+        std::atomic<bool> running;
+        std::thread thread;
+        
+        // Owned by the I/O thread
+        std::map<uint64_t, Client> clients;
+        std::map<int, uint64_t> clientsByFd;
+        uint64_t nextClientId = 1;
+        
+        // Replies queued from the session thread
+        std::mutex outboxMutex;
+        std::vector<std::pair<uint64_t, std::string>> outbox;
+        
+        void run();
+        void acceptClients();
+        void readClient(uint64_t id);
+        void writeClient(uint64_t id);
+        void closeClient(uint64_t id);
+        void drainOutbox();
+        void watch(int fd, bool wantWrite);
+        
+    public:
+        ControlServer(Session* session, std::string path);
+        
+        // Where --daemon listens and "ctl" connects when no socket is given
+        static std::string defaultPath(EdsInt32 cameraIndex);
+        ~ControlServer();
+        
+        void start();
+        void stop();
+        
+        // Thread safe. Queues a line for a client; dropped if it has disconnected.
+        void send(uint64_t client, const std::string& line);
+    };
+}
@@ -0,0 +1,99 @@
+//
+//  DiskSpace.cpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#include "DiskSpace.hpp"
+#include "Logger.hpp"
+
+#include <sys/statvfs.h>
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+
+namespace cc {
+    
+    // ----------------------------------------------------------------------
+    bool DiskSpace::parsePolicy(const std::string& name, DiskPolicy& policy) {
+        if(name == "off") policy = DISK_OFF;
+        else if(name == "warn") policy = DISK_WARN;
+        else if(name == "refuse") policy = DISK_REFUSE;
+        else return false;
+        return true;
+    }
+    
+    // ----------------------------------------------------------------------
+    const char* DiskSpace::policyName(DiskPolicy policy) {
+        switch(policy) {
+            case DISK_OFF: return "off";
+            case DISK_WARN: return "warn";
+            default: return "refuse";
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    void DiskSpace::setPath(const std::string& p) {
+        path = p.empty() ? "." : p;
+        update(true);
+    }
+    
+    // ----------------------------------------------------------------------
+    bool DiskSpace::update(bool force) {
+        auto now = std::chrono::steady_clock::now();
+        if(!force && known && now - refreshed < std::chrono::milliseconds(DISK_REFRESH_INTERVAL)) return false;
+        refreshed = now;
+        
+        struct statvfs st;
+        if(statvfs(path.c_str(), &st) < 0) {
+            if(known) Logger::getInstance()->warning("can't check free space on "+path+": "+strerror(errno));
+            known = false;
+            return false;
+        }
+        // f_bavail: what an unprivileged process may actually use
+        freeBytes = (uint64_t)st.f_bavail * st.f_frsize;
+        totalBytes = (uint64_t)st.f_blocks * st.f_frsize;
+        written = 0;
+        known = true;
+        return true;
+    }
+    
+    // ----------------------------------------------------------------------
+    void DiskSpace::consumed(uint64_t bytes) {
+        written += bytes;
+    }
+    
+    // ----------------------------------------------------------------------
+    void DiskSpace::learn(uint64_t bytes, double seconds) {
+        if(seconds < 1) return;     // too short to say much, and mostly container overhead
+        double r = bytes / seconds;
+        
+        // The first real clip replaces the guess. After that, a moving average
+        // that follows changes of recording settings within a few clips
+        rate = clips == 0 ? r : rate * 0.7 + r * 0.3;
+        clips++;
+    }
+    
+    // ----------------------------------------------------------------------
+    uint64_t DiskSpace::available() {
+        return freeBytes > written ? freeBytes - written : 0;
+    }
+    
+    // ----------------------------------------------------------------------
+    uint64_t DiskSpace::usable() {
+        uint64_t a = available();
+        return a > DISK_MARGIN ? a - DISK_MARGIN : 0;
+    }
+    
+    // ----------------------------------------------------------------------
+    uint64_t DiskSpace::projected(double seconds) {
+        return (uint64_t)(std::max(seconds, 0.0) * rate);
+    }
+    
+    // ----------------------------------------------------------------------
+    double DiskSpace::remaining(uint64_t pending) {
+        uint64_t u = usable();
+        return u > pending ? (u - pending) / rate : 0;
+    }
+}
@@ -0,0 +1,73 @@
+//
+//  DiskSpace.hpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#pragma once
+
+#include <string>
+#include <chrono>
+#include <stdint.h>
+
+#define DISK_REFRESH_INTERVAL 5000              // ms between statvfs calls
+#define DISK_DEFAULT_BITRATE (120000000/8)      // bytes/s until we've downloaded a clip
+#define DISK_RECORD_RESERVE 60                  // seconds that must fit when there's no --max-duration
+#define DISK_MARGIN (256ULL*1024*1024)          // never plan to fill the disk completely
+#define DISK_LOW_SECONDS 60                     // warn when a recording has less than this left
+
+namespace cc {
+    
+    enum DiskPolicy {
+        DISK_OFF,
+        DISK_WARN,      // record anyway, but say so
+        DISK_REFUSE     // don't start a recording that won't fit
+    };
+    
+    //
+    //  Free space where downloads go. statvfs is called every few seconds;
+    //  in between, bytes we write are taken off the cached figure. Clip sizes
+    //  are estimated from the bitrate of the clips already downloaded.
+    //
+    class DiskSpace {
+        
+    private:
+        std::string path;
+        uint64_t freeBytes = 0;
+        uint64_t totalBytes = 0;
+        uint64_t written = 0;           // since the last statvfs
+        bool known = false;
+        std::chrono::steady_clock::time_point refreshed;
+        double rate = DISK_DEFAULT_BITRATE;
+        int clips = 0;                  // how many clips the rate is based on
+        
+    public:
+        DiskPolicy policy = DISK_REFUSE;
+        
+        static bool parsePolicy(const std::string& name, DiskPolicy& policy);
+        static const char* policyName(DiskPolicy policy);
+        
+        void setPath(const std::string& path);
+        
+        // statvfs again if the cached figure is old, or now if forced. True if it did
+        bool update(bool force=false);
+        
+        // Bytes just written under path
+        void consumed(uint64_t bytes);
+        
+        // A downloaded clip of this size and length
+        void learn(uint64_t bytes, double seconds);
+        
+        bool isKnown() { return known; }
+        uint64_t available();           // free bytes, less what we've written since the last look
+        uint64_t total() { return totalBytes; }
+        uint64_t usable();              // available, less DISK_MARGIN
+        double bitrate() { return rate; }
+        int basedOn() { return clips; }
+        uint64_t projected(double seconds);
+        
+        // Seconds of recording that still fit, after `pending` bytes still to come
+        double remaining(uint64_t pending);
+    };
+}
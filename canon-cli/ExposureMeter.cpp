@@ -0,0 +1,105 @@
+//
+//  ExposureMeter.cpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#include "ExposureMeter.hpp"
+#include "Simd.hpp"
+#include "json.hpp"
+
+#include <string.h>
+#include <algorithm>
+
+using json = nlohmann::json;
+
+namespace cc {
+    
+    // ----------------------------------------------------------------------
+    ExposureMeter::ExposureMeter() {
+        memset(last.luma, 0, sizeof(last.luma));
+        memset(last.red, 0, sizeof(last.red));
+        memset(last.green, 0, sizeof(last.green));
+        memset(last.blue, 0, sizeof(last.blue));
+    }
+    
+    // ----------------------------------------------------------------------
+    const ExposureStats& ExposureMeter::update(const Frame& frame) {
+        if(!enabled || frame.width == 0) return last;
+        steady_clock::time_point start = steady_clock::now();
+        
+        size_t pixels = (size_t)frame.width * frame.height;
+        if(y.size() < pixels) y.resize(LIVEVIEW_DECODE_CAPACITY / 3);
+        
+        ExposureStats& s = last;
+        memset(s.luma, 0, sizeof(s.luma));
+        memset(s.red, 0, sizeof(s.red));
+        memset(s.green, 0, sizeof(s.green));
+        memset(s.blue, 0, sizeof(s.blue));
+        
+        simd::luma(frame.rgb.data(), y.data(), pixels);
+        simd::histogram(y.data(), pixels, s.luma);
+        simd::histogramRGB(frame.rgb.data(), pixels, s.red, s.green, s.blue);
+        
+        // Everything else falls out of the histograms
+        uint64_t sum = 0, sumRed = 0, sumGreen = 0, sumBlue = 0, low = 0, high = 0;
+        for(int v=0; v<256; ++v) {
+            sum += (uint64_t)v * s.luma[v];
+            sumRed += (uint64_t)v * s.red[v];
+            sumGreen += (uint64_t)v * s.green[v];
+            sumBlue += (uint64_t)v * s.blue[v];
+            if(v <= EXPOSURE_CLIP_LOW) low += s.luma[v];
+            if(v >= EXPOSURE_CLIP_HIGH) high += s.luma[v];
+        }
+        double n = (double)pixels;
+        s.sequence = frame.sequence;
+        s.pixels = (uint32_t)pixels;
+        s.mean = sum / n;
+        s.meanRed = sumRed / n;
+        s.meanGreen = sumGreen / n;
+        s.meanBlue = sumBlue / n;
+        s.shadows = 100.0 * low / n;
+        s.highlights = 100.0 * high / n;
+        s.clippedRed = 100.0 * s.red[255] / n;
+        s.clippedGreen = 100.0 * s.green[255] / n;
+        s.clippedBlue = 100.0 * s.blue[255] / n;
+        s.processMs = std::chrono::duration<double, std::milli>(steady_clock::now() - start).count();
+        return s;
+    }
+    
+    // ----------------------------------------------------------------------
+    static json binned(const uint32_t* hist, int bins) {
+        json j = json::array();
+        int width = 256 / bins;
+        for(int i=0; i<256; i+=width) {
+            uint32_t count = 0;
+            for(int v=i; v<i+width; ++v) count += hist[v];
+            j.push_back(count);
+        }
+        return j;
+    }
+    
+    // ----------------------------------------------------------------------
+    json ExposureMeter::toJSON(const ExposureStats& s, int bins) {
+        bins = bins >= 256 ? 256 : std::max(1, bins);
+        json j;
+        j["frame"] = s.sequence;
+        j["pixels"] = s.pixels;
+        j["mean"] = s.mean;
+        j["meanRed"] = s.meanRed;
+        j["meanGreen"] = s.meanGreen;
+        j["meanBlue"] = s.meanBlue;
+        j["shadows"] = s.shadows;
+        j["highlights"] = s.highlights;
+        j["clippedRed"] = s.clippedRed;
+        j["clippedGreen"] = s.clippedGreen;
+        j["clippedBlue"] = s.clippedBlue;
+        j["processMs"] = s.processMs;
+        j["histogram"]["luma"] = binned(s.luma, bins);
+        j["histogram"]["red"] = binned(s.red, bins);
+        j["histogram"]["green"] = binned(s.green, bins);
+        j["histogram"]["blue"] = binned(s.blue, bins);
+        return j;
+    }
+}
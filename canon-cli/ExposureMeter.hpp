@@ -0,0 +1,61 @@
+//
+//  ExposureMeter.hpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "LiveView.hpp"
+#include "json.hpp"
+
+#define EXPOSURE_CLIP_LOW 4        // luma at or below this counts as crushed shadows
+#define EXPOSURE_CLIP_HIGH 251     // luma at or above this counts as blown highlights
+#define EXPOSURE_EVENT_BINS 64     // histograms in per-frame events are binned down to this
+
+namespace cc {
+    
+    struct ExposureStats {
+        uint64_t sequence = 0;      // live view frame these came from
+        uint32_t pixels = 0;
+        uint32_t luma[256];
+        uint32_t red[256];
+        uint32_t green[256];
+        uint32_t blue[256];
+        double mean = 0;            // luma, 0-255
+        double meanRed = 0, meanGreen = 0, meanBlue = 0;
+        double shadows = 0;         // % of pixels at or below EXPOSURE_CLIP_LOW
+        double highlights = 0;      // % of pixels at or above EXPOSURE_CLIP_HIGH
+        double clippedRed = 0;      // % of pixels with the channel at 255
+        double clippedGreen = 0;
+        double clippedBlue = 0;
+        double processMs = 0;
+    };
+    
+    //
+    //  Histograms and exposure numbers for decoded live view frames. Luma
+    //  conversion is vectorized (see Simd.hpp); at the decode size a frame costs
+    //  a fraction of a millisecond, so it runs on every frame while enabled.
+    //
+    class ExposureMeter {
+        
+    private:
+        std::vector<uint8_t> y;    // luma scratch, sized once
+        ExposureStats last;
+        
+    public:
+        ExposureMeter();
+        
+        bool enabled = false;
+        
+        // Session thread
+        const ExposureStats& update(const Frame& frame);
+        const ExposureStats& stats() { return last; }
+        
+        // binned histograms when bins < 256
+        static nlohmann::json toJSON(const ExposureStats& stats, int bins);
+    };
+}
@@ -0,0 +1,121 @@
+//
+//  Finalizer.cpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#include "Finalizer.hpp"
+#include "Logger.hpp"
+
+#include <set>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <libgen.h>
+#include <sstream>
+
+namespace cc {
+    
+    // fsync on macOS only gets the data as far as the drive's cache
+    static int flushFile(int fd, bool full) {
+#ifdef F_FULLFSYNC
+        if(full && fcntl(fd, F_FULLFSYNC) == 0) return 0;
+#else
+        (void)full;
+#endif
+        return fsync(fd);
+    }
+    
+    // So the rename itself survives a crash
+    static void flushFolder(const std::string& folder) {
+        int fd = ::open(folder.c_str(), O_RDONLY);
+        if(fd < 0) return;
+        fsync(fd);
+        ::close(fd);
+    }
+    
+    // ----------------------------------------------------------------------
+    bool Finalizer::parsePolicy(const std::string& name, SyncPolicy& policy) {
+        if(name == "none") policy = SYNC_NONE;
+        else if(name == "file") policy = SYNC_FILE;
+        else if(name == "group") policy = SYNC_GROUP;
+        else return false;
+        return true;
+    }
+    
+    // ----------------------------------------------------------------------
+    const char* Finalizer::policyName(SyncPolicy policy) {
+        switch(policy) {
+            case SYNC_FILE: return "file";
+            case SYNC_GROUP: return "group";
+            default: return "none";
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    void Finalizer::submit(int fd, const std::string& part, const std::string& path, finalizeCallback done) {
+        if(queue.empty()) oldest = std::chrono::steady_clock::now();
+        queue.push_back({ fd, part, path, done });
+        if(policy != SYNC_GROUP) commit();
+    }
+    
+    // ----------------------------------------------------------------------
+    void Finalizer::update() {
+        if(!queue.empty() && untilDue().count() == 0) commit();
+    }
+    
+    // ----------------------------------------------------------------------
+    void Finalizer::flush() {
+        if(!queue.empty()) commit();
+    }
+    
+    // ----------------------------------------------------------------------
+    std::chrono::milliseconds Finalizer::untilDue() {
+        if(queue.empty()) return std::chrono::milliseconds(interval);
+        auto due = oldest + std::chrono::milliseconds(interval);
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(due - std::chrono::steady_clock::now());
+        return std::max(left, std::chrono::milliseconds(0));
+    }
+    
+    // ----------------------------------------------------------------------
+    void Finalizer::commit() {
+        std::vector<pending> batch;
+        batch.swap(queue);
+        std::vector<std::string> errors(batch.size());
+        
+        // Data first. In a group only the last flush needs to reach the platters
+        if(policy != SYNC_NONE) {
+            for(size_t i = 0; i < batch.size(); i++) {
+                bool last = policy == SYNC_FILE || i == batch.size()-1;
+                if(flushFile(batch[i].fd, last) < 0) errors[i] = std::string("fsync: ")+strerror(errno);
+            }
+        }
+        
+        // Then names. A file that didn't make it to disk keeps its .part name
+        std::set<std::string> folders;
+        for(size_t i = 0; i < batch.size(); i++) {
+            if(::close(batch[i].fd) < 0 && errors[i].empty()) errors[i] = std::string("close: ")+strerror(errno);
+            if(!errors[i].empty()) continue;
+            if(rename(batch[i].part.c_str(), batch[i].path.c_str()) < 0) {
+                errors[i] = std::string("rename: ")+strerror(errno);
+                continue;
+            }
+            std::string copy = batch[i].path;
+            folders.insert(dirname(&copy[0]));
+        }
+        if(policy != SYNC_NONE) {
+            for(const std::string& folder : folders) flushFolder(folder);
+        }
+        
+        if(batch.size() > 1) {
+            std::stringstream ss;
+            ss << "committed " << batch.size() << " files";
+            Logger::getInstance()->status(ss.str());
+        }
+        for(size_t i = 0; i < batch.size(); i++) {
+            if(batch[i].done) batch[i].done(errors[i]);
+        }
+    }
+}
@@ -0,0 +1,73 @@
+//
+//  Finalizer.hpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+
+#define FINALIZE_PART_SUFFIX ".part"
+#define FINALIZE_GROUP_INTERVAL 100     // ms a finished file may wait for the group fsync
+
+namespace cc {
+    
+    enum SyncPolicy {
+        SYNC_NONE,      // rename as soon as the data is written, leave flushing to the OS
+        SYNC_FILE,      // fsync each file (and its folder) before reporting it
+        SYNC_GROUP      // fsync everything finished in the last interval together
+    };
+    
+    // Called once the file is under its final name, or with what went wrong
+    typedef std::function<void(const std::string& error)> finalizeCallback;
+    
+    //
+    //  Downloads are written to "<path>.part" and handed here when the last
+    //  byte is in. The rename to the real name happens only after the data is
+    //  as durable as the policy asks for, so a name that exists is always a
+    //  whole file.
+    //
+    //  With SYNC_GROUP a burst of stills shares one flush: on macOS a single
+    //  F_FULLFSYNC empties the drive's cache for all of them.
+    //
+    class Finalizer {
+        
+    private:
+        struct pending {
+            int fd;
+            std::string part;
+            std::string path;
+            finalizeCallback done;
+        };
+        
+        std::vector<pending> queue;
+        std::chrono::steady_clock::time_point oldest;
+        
+        void commit();
+        
+    public:
+        SyncPolicy policy = SYNC_NONE;
+        int interval = FINALIZE_GROUP_INTERVAL;    // ms, for SYNC_GROUP
+        
+        static bool parsePolicy(const std::string& name, SyncPolicy& policy);
+        static const char* policyName(SyncPolicy policy);
+        
+        // Takes over fd. done may run before this returns
+        void submit(int fd, const std::string& part, const std::string& path, finalizeCallback done);
+        
+        // Run the group commit if it is due
+        void update();
+        
+        // Commit everything that is waiting, now. The owner calls this before
+        // it goes away, since the callbacks point back at it
+        void flush();
+        
+        size_t waiting() { return queue.size(); }
+        std::chrono::milliseconds untilDue();
+    };
+}
@@ -0,0 +1,55 @@
+//
+//  FocusMeter.cpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#include "FocusMeter.hpp"
+#include "Simd.hpp"
+
+#include <algorithm>
+
+namespace cc {
+    
+    // ----------------------------------------------------------------------
+    FocusMeter::FocusMeter() {
+        
+    }
+    
+    // ----------------------------------------------------------------------
+    void FocusMeter::reset() {
+        peak = 0;
+    }
+    
+    // ----------------------------------------------------------------------
+    double FocusMeter::update(const Frame& f) {
+        if(!enabled || f.width < 3 || f.height < 3) return score;
+        steady_clock::time_point start = steady_clock::now();
+        
+        size_t pixels = (size_t)f.width * f.height;
+        if(y.size() < pixels) y.resize(LIVEVIEW_DECODE_CAPACITY / 3);
+        simd::luma(f.rgb.data(), y.data(), pixels);
+        
+        // The kernel reads one pixel around the region, so keep it off the edges
+        int x0, y0, x1, y1;
+        roi.pixels(f.width, f.height, x0, y0, x1, y1);
+        x0 = std::max(x0, 1);
+        y0 = std::max(y0, 1);
+        x1 = std::min(x1, f.width-1);
+        y1 = std::min(y1, f.height-1);
+        if(x1 <= x0 || y1 <= y0) return score;
+        
+        int64_t sum = 0;
+        uint64_t sumSq = 0;
+        simd::laplacian(y.data() + (size_t)y0*f.width + x0, f.width, x1-x0, y1-y0, &sum, &sumSq);
+        
+        double n = (double)(x1-x0) * (y1-y0);
+        double mean = sum / n;
+        score = sumSq / n - mean * mean;
+        peak = std::max(peak, score);
+        frame = f.sequence;
+        processMs = std::chrono::duration<double, std::milli>(steady_clock::now() - start).count();
+        return score;
+    }
+}
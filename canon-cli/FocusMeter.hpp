@@ -0,0 +1,43 @@
+//
+//  FocusMeter.hpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "LiveView.hpp"
+
+namespace cc {
+    
+    //
+    //  Sharpness of decoded live view frames: the variance of the Laplacian of
+    //  luma inside a region. Higher is sharper. The number depends on the scene
+    //  and the decode width, so compare it across cameras looking at the same
+    //  thing, or watch it peak while focusing.
+    //
+    class FocusMeter {
+        
+    private:
+        std::vector<uint8_t> y;     // luma scratch, sized once
+        
+    public:
+        FocusMeter();
+        
+        bool enabled = false;
+        Region roi;
+        
+        // Last results
+        double score = 0;
+        double peak = 0;            // highest score since enabled or reset
+        uint64_t frame = 0;         // live view sequence of score
+        double processMs = 0;
+        
+        // Session thread
+        double update(const Frame& frame);
+        void reset();
+    };
+}
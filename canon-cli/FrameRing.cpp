@@ -0,0 +1,192 @@
+//
+//  FrameRing.cpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#include "FrameRing.hpp"
+#include "StatusPage.hpp"
+#include "Logger.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <atomic>
+#include <sstream>
+#include <algorithm>
+
+namespace cc {
+    
+    // ----------------------------------------------------------------------
+    FrameRing::FrameRing() {
+        
+    }
+    
+    // ----------------------------------------------------------------------
+    FrameRing::~FrameRing() {
+        close();
+    }
+    
+    // ----------------------------------------------------------------------
+    std::string FrameRing::ringName(int32_t cameraIndex) {
+        std::stringstream ss;
+        ss << "/canon-cli-" << cameraIndex << "-frames";
+        return ss.str();
+    }
+    
+    // ----------------------------------------------------------------------
+    FrameSlot* FrameRing::slotAt(uint64_t sequence) const {
+        return (FrameSlot*)(base + sizeof(FrameRingHeader) + (size_t)(sequence % header->slots) * header->slotSize);
+    }
+    
+    // ----------------------------------------------------------------------
+    void FrameRing::open(int32_t cameraIndex, bool decoded) {
+        if(header) return;
+        name = ringName(cameraIndex);
+        
+        uint32_t jpegCapacity = LIVEVIEW_FRAME_CAPACITY;
+        uint32_t rgbCapacity = decoded ? LIVEVIEW_DECODE_CAPACITY : 0;
+        uint32_t slotSize = (sizeof(FrameSlot) + jpegCapacity + rgbCapacity + 63) & ~63u;
+        length = sizeof(FrameRingHeader) + (size_t)FRAME_RING_SLOTS * slotSize;
+        
+        // Start from a fresh object: a stale one from a crashed run may have another size
+        shm_unlink(name.c_str());
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if(fd < 0) {
+            Logger::getInstance()->warning("can't create frame ring "+name+": "+strerror(errno));
+            return;
+        }
+        if(ftruncate(fd, length) < 0) {
+            Logger::getInstance()->warning("can't size frame ring "+name+": "+strerror(errno));
+            ::close(fd);
+            shm_unlink(name.c_str());
+            return;
+        }
+        void* p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(p == MAP_FAILED) {
+            Logger::getInstance()->warning("can't map frame ring "+name+": "+strerror(errno));
+            shm_unlink(name.c_str());
+            return;
+        }
+        
+        // New shm objects are zero filled, so every slot starts out unlocked and empty
+        base = (unsigned char*)p;
+        header = (FrameRingHeader*)p;
+        header->version = FRAME_RING_VERSION;
+        header->slots = FRAME_RING_SLOTS;
+        header->slotSize = slotSize;
+        header->jpegCapacity = jpegCapacity;
+        header->rgbCapacity = rgbCapacity;
+        header->pid = getpid();
+        header->cameraIndex = cameraIndex;
+        __atomic_store_n(&header->magic, FRAME_RING_MAGIC, __ATOMIC_RELEASE);
+        writer = true;
+        Logger::getInstance()->status("publishing live view frames on "+name);
+    }
+    
+    // ----------------------------------------------------------------------
+    void FrameRing::publish(const Frame& frame) {
+        if(!header || !writer) return;
+        
+        FrameSlot* slot = slotAt(frame.sequence);
+        unsigned char* payload = (unsigned char*)(slot + 1);
+        
+        uint64_t lock = __atomic_load_n(&slot->lock, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->lock, lock+1, __ATOMIC_RELAXED);
+        std::atomic_thread_fence(std::memory_order_release);
+        
+        slot->sequence = frame.sequence;
+        slot->timestamp = StatusPage::now() - std::chrono::duration_cast<std::chrono::milliseconds>(steady_clock::now() - frame.timestamp).count();
+        slot->monotonic = std::chrono::duration_cast<std::chrono::nanoseconds>(frame.timestamp.time_since_epoch()).count();
+        slot->jpegSize = (uint32_t)std::min(frame.size, (size_t)header->jpegCapacity);
+        memcpy(payload, frame.data.data(), slot->jpegSize);
+        
+        size_t rgbSize = (size_t)frame.width * frame.height * 3;
+        if(header->rgbCapacity && frame.width > 0 && rgbSize <= header->rgbCapacity) {
+            memcpy(payload + header->jpegCapacity, frame.rgb.data(), rgbSize);
+            slot->rgbSize = (uint32_t)rgbSize;
+            slot->width = frame.width;
+            slot->height = frame.height;
+        } else {
+            slot->rgbSize = slot->width = slot->height = 0;
+        }
+        
+        __atomic_store_n(&slot->lock, lock+2, __ATOMIC_RELEASE);
+        __atomic_store_n(&header->head, frame.sequence, __ATOMIC_RELEASE);
+    }
+    
+    // ----------------------------------------------------------------------
+    bool FrameRing::attach(int32_t cameraIndex) {
+        if(header) return true;
+        name = ringName(cameraIndex);
+        
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if(fd < 0) return false;
+        struct stat st;
+        if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(FrameRingHeader)) {
+            ::close(fd);
+            return false;
+        }
+        void* p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(p == MAP_FAILED) return false;
+        
+        FrameRingHeader* h = (FrameRingHeader*)p;
+        if(__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != FRAME_RING_MAGIC || h->version != FRAME_RING_VERSION
+           || sizeof(FrameRingHeader) + (size_t)h->slots * h->slotSize > (size_t)st.st_size) {
+            munmap(p, st.st_size);
+            return false;
+        }
+        base = (unsigned char*)p;
+        header = h;
+        length = st.st_size;
+        writer = false;
+        return true;
+    }
+    
+    // ----------------------------------------------------------------------
+    bool FrameRing::next(uint64_t after, FrameView& view) const {
+        if(!header) return false;
+        uint64_t head = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+        if(head == 0 || head <= after) return false;
+        
+        const FrameSlot* slot = slotAt(head);
+        view.slot = slot;
+        view.lock = __atomic_load_n(&slot->lock, __ATOMIC_ACQUIRE);
+        if(view.lock & 1) return false;
+        
+        const unsigned char* payload = (const unsigned char*)(slot + 1);
+        view.sequence = slot->sequence;
+        view.timestamp = slot->timestamp;
+        view.monotonic = slot->monotonic;
+        view.jpeg = payload;
+        view.jpegSize = std::min((size_t)slot->jpegSize, (size_t)header->jpegCapacity);
+        bool rgb = slot->rgbSize > 0 && slot->rgbSize <= header->rgbCapacity;
+        view.rgb = rgb ? payload + header->jpegCapacity : NULL;
+        view.width = rgb ? slot->width : 0;
+        view.height = rgb ? slot->height : 0;
+        return valid(view) && view.sequence == head;
+    }
+    
+    // ----------------------------------------------------------------------
+    bool FrameRing::valid(const FrameView& view) const {
+        if(!header || !view.slot) return false;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return __atomic_load_n(&view.slot->lock, __ATOMIC_RELAXED) == view.lock;
+    }
+    
+    // ----------------------------------------------------------------------
+    void FrameRing::close() {
+        if(!header) return;
+        munmap(base, length);
+        if(writer) shm_unlink(name.c_str());
+        base = NULL;
+        header = NULL;
+        writer = false;
+    }
+}
@@ -0,0 +1,103 @@
+//
+//  FrameRing.hpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#pragma once
+
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+#include "LiveView.hpp"
+
+#define FRAME_RING_MAGIC 0x43414e46 // "CANF"
+#define FRAME_RING_VERSION 1
+#define FRAME_RING_SLOTS LIVEVIEW_SLOTS
+
+namespace cc {
+    
+    //
+    //  Shared memory layout of "/canon-cli-<id>-frames": one FrameRingHeader,
+    //  then FrameRingHeader::slots slots of slotSize bytes each. A slot is a
+    //  FrameSlot followed by jpegCapacity bytes of JPEG and rgbCapacity bytes of
+    //  packed RGB. Frame n always goes to slot n % slots. Plain C types only;
+    //  don't reorder.
+    //
+    struct FrameRingHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t slots;
+        uint32_t slotSize;
+        uint32_t jpegCapacity;
+        uint32_t rgbCapacity;
+        int32_t pid;
+        int32_t cameraIndex;
+        uint64_t head;              // sequence of the newest complete frame. 0 before the first
+        uint64_t reserved[3];
+    };
+    
+    struct FrameSlot {
+        uint64_t lock;              // seqlock. odd while the slot is being written
+        uint64_t sequence;          // live view frame number
+        int64_t timestamp;          // ms since epoch
+        int64_t monotonic;          // ns, steady clock, for frame intervals
+        uint32_t jpegSize;
+        uint32_t rgbSize;           // 0 unless decoded frames were asked for
+        uint32_t width;             // of the RGB frame
+        uint32_t height;
+        uint64_t reserved;
+    };
+    
+    // A frame read in place. Only trust what you read from it if valid() still
+    // says so afterwards; the writer may have lapped you.
+    struct FrameView {
+        const FrameSlot* slot = NULL;
+        uint64_t lock = 0;
+        uint64_t sequence = 0;
+        int64_t timestamp = 0;
+        int64_t monotonic = 0;
+        const unsigned char* jpeg = NULL;
+        size_t jpegSize = 0;
+        const unsigned char* rgb = NULL;
+        int width = 0;
+        int height = 0;
+    };
+    
+    //
+    //  Live view frames for other processes on this machine, without a socket
+    //  and without opening the camera twice. One writer (the session thread),
+    //  any number of readers, no locks: each slot is a seqlock and the header's
+    //  head says which frame is newest.
+    //
+    class FrameRing {
+        
+    private:
+        std::string name;
+        bool writer = false;
+        unsigned char* base = NULL;
+        size_t length = 0;
+        FrameRingHeader* header = NULL;
+        
+        FrameSlot* slotAt(uint64_t sequence) const;
+        
+    public:
+        FrameRing();
+        ~FrameRing();
+        
+        static std::string ringName(int32_t cameraIndex);
+        
+        // Writer side, session thread only. Failure is logged, not thrown.
+        void open(int32_t cameraIndex, bool decoded);
+        void publish(const Frame& frame);
+        
+        // Reader side
+        bool attach(int32_t cameraIndex);
+        bool next(uint64_t after, FrameView& view) const;    // newest frame with sequence > after
+        bool valid(const FrameView& view) const;
+        
+        bool isOpen() const { return header != NULL; }
+        void close();
+    };
+}
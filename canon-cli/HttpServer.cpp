@@ -0,0 +1,426 @@
+//
+//  HttpServer.cpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#include "HttpServer.hpp"
+#include "json.hpp"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <string.h>
+#include <memory>
+#include <sstream>
+
+#ifdef MSG_NOSIGNAL
+#define HTTP_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define HTTP_SEND_FLAGS 0
+#endif
+
+using json = nlohmann::json;
+
+namespace cc {
+    
+    static const char* statusText(int status) {
+        switch(status) {
+            case 200: return "OK";
+            case 400: return "Bad Request";
+            case 403: return "Forbidden";
+            case 404: return "Not Found";
+            case 405: return "Method Not Allowed";
+            case 413: return "Payload Too Large";
+            case 415: return "Unsupported Media Type";
+            case 503: return "Service Unavailable";
+            case 504: return "Gateway Timeout";
+            default: return "Internal Server Error";
+        }
+    }
+    
+    static std::string lower(std::string s) {
+        std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+        return s;
+    }
+    
+    // "%3A" and "+" in a query string
+    static std::string percentDecode(const std::string& s) {
+        std::string out;
+        for(size_t i = 0; i < s.size(); i++) {
+            if(s[i] == '+') {
+                out += ' ';
+            } else if(s[i] == '%' && i+2 < s.size() && isxdigit((unsigned char)s[i+1]) && isxdigit((unsigned char)s[i+2])) {
+                out += (char)strtol(s.substr(i+1, 2).c_str(), NULL, 16);
+                i += 2;
+            } else {
+                out += s[i];
+            }
+        }
+        return out;
+    }
+    
+    // ----------------------------------------------------------------------
+    HttpServer::HttpServer(Session* session, int port, int workers) :
+    session(session),
+    port(port),
+    workerCount(workers),
+    running(false) {
+        
+    }
+    
+    // ----------------------------------------------------------------------
+    HttpServer::~HttpServer() {
+        stop();
+    }
+    
+    // ----------------------------------------------------------------------
+    void HttpServer::start() {
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        if(listenFd < 0)
+            throw std::runtime_error(std::string("socket: ")+strerror(errno));
+        
+        int one = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if(bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+            throw std::runtime_error("bind port "+std::to_string(port)+": "+strerror(errno));
+        if(listen(listenFd, HTTP_MAX_BACKLOG) < 0)
+            throw std::runtime_error(std::string("listen: ")+strerror(errno));
+        
+        std::stringstream ss;
+        ss << "http listening on 127.0.0.1:" << port << " with " << workerCount << " workers";
+        Logger::getInstance()->status(ss.str());
+        
+        running = true;
+        acceptor = std::thread(&HttpServer::acceptLoop, this);
+        for(int i=0; i<workerCount; ++i)
+            workers.push_back(std::thread(&HttpServer::workerLoop, this));
+    }
+    
+    // ----------------------------------------------------------------------
+    void HttpServer::stop() {
+        if(!running) return;
+        running = false;
+        
+        acceptor.join();
+        close(listenFd);
+        listenFd = -1;
+        
+        // Unblock any worker sitting in recv() on an idle keep-alive connection
+        connectionsMutex.lock();
+        for(int fd : active) shutdown(fd, SHUT_RDWR);
+        connectionsMutex.unlock();
+        
+        connectionsCv.notify_all();
+        for(std::thread& t : workers) t.join();
+        workers.clear();
+        
+        for(int fd : connections) close(fd);
+        connections.clear();
+    }
+    
+    // ----------------------------------------------------------------------
+    void HttpServer::acceptLoop() {
+        while(running) {
+            struct pollfd pfd = {listenFd, POLLIN, 0};
+            if(poll(&pfd, 1, 500) <= 0) continue; // wake up now and then to check running
+            
+            int fd = accept(listenFd, NULL, NULL);
+            if(fd < 0) {
+                if(errno == EINTR) continue;
+                if(running) Logger::getInstance()->error(std::string("http accept: ")+strerror(errno), LOG_SITE);
+                continue;
+            }
+            
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+            setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+            struct timeval tv = {HTTP_IDLE_TIMEOUT, 0};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            
+            std::unique_lock<std::mutex> lock(connectionsMutex);
+            if(connections.size() >= HTTP_MAX_BACKLOG) {
+                lock.unlock();
+                writeResponse(fd, 503, "{\"error\":\"busy\"}", false);
+                close(fd);
+                continue;
+            }
+            connections.push_back(fd);
+            lock.unlock();
+            connectionsCv.notify_one();
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    void HttpServer::workerLoop() {
+        while(true) {
+            std::unique_lock<std::mutex> lock(connectionsMutex);
+            connectionsCv.wait(lock, [this]{ return !running || !connections.empty(); });
+            if(!running) return;
+            int fd = connections.front();
+            connections.pop_front();
+            active.insert(fd);
+            lock.unlock();
+            
+            serve(fd);
+            
+            lock.lock();
+            active.erase(fd);
+            lock.unlock();
+            close(fd);
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    void HttpServer::serve(int fd) {
+        std::string buffer;
+        Request req;
+        while(running && readRequest(fd, buffer, req)) {
+            int status = 200;
+            std::string body;
+            try {
+                route(req, status, body);
+            } catch(std::exception& e) {
+                status = 500;
+                json j;
+                j["error"] = e.what();
+                body = j.dump();
+            }
+            if(!writeResponse(fd, status, body, req.keepAlive) || !req.keepAlive)
+                return;
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    // Read one request off the connection. Bytes past the end of it (pipelined
+    // requests) stay in buffer for the next call.
+    bool HttpServer::readRequest(int fd, std::string& buffer, Request& req) {
+        size_t headerEnd;
+        while((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+            if(buffer.size() > HTTP_MAX_HEADER) return false;
+            char chunk[4096];
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if(n <= 0) return false; // closed, error or idle timeout
+            buffer.append(chunk, n);
+        }
+        
+        std::istringstream head(buffer.substr(0, headerEnd));
+        std::string line, version;
+        std::getline(head, line);
+        std::istringstream requestLine(line);
+        requestLine >> req.method >> req.path >> version;
+        if(req.method.empty() || req.path.empty()) return false;
+        
+        size_t q = req.path.find('?');
+        req.query = q == std::string::npos ? "" : req.path.substr(q+1);
+        if(q != std::string::npos) req.path.erase(q);
+        
+        req.keepAlive = version.compare("HTTP/1.0") != 0;
+        req.host.clear();
+        req.origin.clear();
+        req.contentType.clear();
+        req.customHeader = false;
+        size_t contentLength = 0;
+        while(std::getline(head, line)) {
+            size_t colon = line.find(':');
+            if(colon == std::string::npos) continue;
+            std::string name = lower(line.substr(0, colon));
+            std::string value = line.substr(colon+1);
+            value.erase(0, value.find_first_not_of(" \t"));
+            value.erase(value.find_last_not_of(" \t\r")+1);
+            
+            if(name.compare("content-length")==0) {
+                contentLength = strtoul(value.c_str(), NULL, 10);
+            } else if(name.compare("connection")==0) {
+                std::string v = lower(value);
+                if(v.compare("close")==0) req.keepAlive = false;
+                if(v.compare("keep-alive")==0) req.keepAlive = true;
+            } else if(name.compare("host")==0) {
+                req.host = lower(value);
+            } else if(name.compare("origin")==0) {
+                req.origin = lower(value);
+            } else if(name.compare("content-type")==0) {
+                req.contentType = lower(value.substr(0, value.find(';')));
+                req.contentType.erase(req.contentType.find_last_not_of(" \t")+1);
+            } else if(name.compare("x-canon-cli")==0) {
+                req.customHeader = true;
+            }
+        }
+        if(contentLength > HTTP_MAX_BODY) {
+            writeResponse(fd, 413, "{\"error\":\"body too large\"}", false);
+            return false;
+        }
+        
+        buffer.erase(0, headerEnd+4);
+        while(buffer.size() < contentLength) {
+            char chunk[4096];
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if(n <= 0) return false;
+            buffer.append(chunk, n);
+        }
+        req.body = buffer.substr(0, contentLength);
+        buffer.erase(0, contentLength);
+        return true;
+    }
+    
+    // ----------------------------------------------------------------------
+    // A Host header (port optional) naming this machine. Anything else is a page
+    // whose own host name has been pointed at 127.0.0.1
+    bool HttpServer::local(const std::string& host) {
+        std::string name = host;
+        size_t colon = name.rfind(':');
+        if(colon != std::string::npos && name.find(']', colon) == std::string::npos) {
+            if(name.substr(colon+1).compare(std::to_string(port)) != 0) return false;
+            name.erase(colon);
+        }
+        return name.compare("127.0.0.1")==0 || name.compare("localhost")==0 || name.compare("[::1]")==0;
+    }
+    
+    // ----------------------------------------------------------------------
+    void HttpServer::route(const Request& req, int& status, std::string& body) {
+        bool get = req.method.compare("GET")==0;
+        bool post = req.method.compare("POST")==0;
+        
+        if(!local(req.host) || (!req.origin.empty() && !local(req.origin.substr(req.origin.find("://") == std::string::npos ? 0 : req.origin.find("://")+3)))) {
+            Logger::getInstance()->warning("http: refused a request for "+req.path+" from host \""+req.host+"\", origin \""+req.origin+"\"");
+            status = 403;
+            body = "{\"error\":\"only local clients\"}";
+            return;
+        }
+        
+        if(req.path.compare("/state")==0 || req.path.compare("/devices")==0 || req.path.compare("/captures")==0) {
+            if(!get) {
+                status = 405;
+                body = "{\"error\":\"use GET\"}";
+                return;
+            }
+            command cmd;
+            cmd.push_back(req.path.substr(1));
+            
+            // /captures?since=...&until=...&camera=...&limit=... become "captures since ..."
+            std::istringstream params(req.path.compare("/captures")==0 ? req.query : "");
+            for(std::string param; std::getline(params, param, '&');) {
+                size_t eq = param.find('=');
+                if(eq == std::string::npos || eq+1 == param.size()) continue;
+                cmd.push_back(percentDecode(param.substr(0, eq)));
+                cmd.push_back(percentDecode(param.substr(eq+1)));
+            }
+            body = call(cmd, false, status);
+        }
+        else if(req.path.compare("/command")==0) {
+            if(!post) {
+                status = 405;
+                body = "{\"error\":\"use POST\"}";
+                return;
+            }
+            // Both need a preflight from a browser, which is never answered
+            std::string line;
+            if(req.contentType.compare("application/json")==0) {
+                json j = json::parse(req.body, nullptr, false);
+                if(j.is_object() && j.count("command") && j["command"].is_string()) line = j["command"];
+                else if(j.is_string()) line = j;
+                else {
+                    status = 400;
+                    body = "{\"error\":\"body should be an object with a \\\"command\\\" string\"}";
+                    return;
+                }
+            } else if(req.customHeader) {
+                line = req.body;
+            } else {
+                status = 415;
+                body = "{\"error\":\"send Content-Type: application/json, or an X-Canon-CLI header with a plain command line\"}";
+                return;
+            }
+            command cmd = Session::parseCommand(line);
+            if(cmd.empty()) {
+                status = 400;
+                body = "{\"error\":\"empty command\"}";
+                return;
+            }
+            body = call(cmd, req.query.find("wait=done") != std::string::npos, status);
+        }
+        else {
+            status = 404;
+            body = "{\"error\":\"not found\"}";
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    // Queue a command and block until its result (or its last event) comes back.
+    std::string HttpServer::call(const command& cmd, bool waitDone, int& status) {
+        struct Reply {
+            std::mutex mutex;
+            std::condition_variable cv;
+            json events = json::array();
+            bool result = false;
+            bool done = false;
+        };
+        // Shared with the responder, which may outlive this call if we time out
+        std::shared_ptr<Reply> reply = std::make_shared<Reply>();
+        
+        // Anything that keeps sending events ("watch") stops once we've answered
+        connection connected = std::make_shared<std::atomic<bool>>(true);
+        
+        session->addCommand(cmd, [reply](const std::string& line) {
+            json event = json::parse(line);
+            std::lock_guard<std::mutex> lock(reply->mutex);
+            if(event["event"] == "result") reply->result = true;
+            if(event.count("done")) reply->done = true;
+            reply->events.push_back(event);
+            reply->cv.notify_all();
+        }, connected);
+        
+        std::unique_lock<std::mutex> lock(reply->mutex);
+        bool finished = reply->cv.wait_for(lock, std::chrono::seconds(HTTP_COMMAND_TIMEOUT), [&]{
+            return reply->done || (reply->result && !waitDone);
+        });
+        *connected = false;
+        
+        json body;
+        body["events"] = reply->events;
+        for(json& event : reply->events) {
+            if(event["event"] == "result") {
+                body["result"] = event;
+                if(event["status"] != "ok") status = 400;
+            }
+        }
+        if(!finished) {
+            status = 504;
+            body["error"] = "timed out waiting for the session";
+        }
+        return body.dump();
+    }
+    
+    // ----------------------------------------------------------------------
+    bool HttpServer::writeResponse(int fd, int status, const std::string& body, bool keepAlive) {
+        std::stringstream ss;
+        ss << "HTTP/1.1 " << status << " " << statusText(status) << "\r\n"
+           << "Content-Type: application/json\r\n"
+           << "Content-Length: " << body.size() << "\r\n"
+           << "Connection: " << (keepAlive ? "keep-alive" : "close") << "\r\n"
+           << "\r\n" << body;
+        std::string response = ss.str();
+        
+        size_t sent = 0;
+        while(sent < response.size()) {
+            ssize_t n = send(fd, response.data()+sent, response.size()-sent, HTTP_SEND_FLAGS);
+            if(n < 0 && errno == EINTR) continue;
+            if(n <= 0) return false;
+            sent += n;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,89 @@
+//
+//  HttpServer.hpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "Session.hpp"
+
+#define HTTP_MAX_HEADER 8192
+#define HTTP_MAX_BODY 65536
+#define HTTP_MAX_BACKLOG 64
+#define HTTP_IDLE_TIMEOUT 5      // seconds a keep-alive connection may sit idle
+#define HTTP_COMMAND_TIMEOUT 10  // seconds to wait on the session for a reply
+
+namespace cc {
+    
+    //
+    //  Minimal HTTP/1.1 server bound to localhost. One thread accepts, a fixed
+    //  number of workers each serve one keep-alive connection at a time.
+    //
+    //    GET  /state               session state
+    //    GET  /devices             connected cameras
+    //    GET  /captures            recently finalized downloads
+    //    POST /command[?wait=done] body is a command line, eg "stop out.mp4".
+    //                              replies with the events up to the result, or
+    //                              up to the last event with wait=done
+    //
+    //  Web pages in the operator's browser can reach localhost too. Requests
+    //  must name a local Host (no DNS rebinding) and come from no Origin or
+    //  our own, and /command takes either "Content-Type: application/json"
+    //  with {"command": "..."} or a plain command line with an X-Canon-CLI
+    //  header. A page can send neither without a preflight we never answer.
+    //
+    class HttpServer {
+        
+    private:
+        struct Request {
+            std::string method;
+            std::string path;
+            std::string query;
+            std::string body;
+            std::string host;
+            std::string origin;
+            std::string contentType;
+            bool customHeader = false;  // X-Canon-CLI
+            bool keepAlive = true;
+        };
+        
+        Session* session;
+        int port;
+        int workerCount;
+        int listenFd = -1;
+        std::atomic<bool> running;
+        std::thread acceptor;
+        std::vector<std::thread> workers;
+        
+        std::deque<int> connections;    // accepted, waiting for a worker
+        std::set<int> active;           // being served
+        std::mutex connectionsMutex;
+        std::condition_variable connectionsCv;
+        
+        void acceptLoop();
+        void workerLoop();
+        void serve(int fd);
+        bool readRequest(int fd, std::string& buffer, Request& req);
+        bool local(const std::string& host);
+        void route(const Request& req, int& status, std::string& body);
+        std::string call(const command& cmd, bool waitDone, int& status);
+        bool writeResponse(int fd, int status, const std::string& body, bool keepAlive);
+        
+    public:
+        HttpServer(Session* session, int port, int workers);
+        ~HttpServer();
+        
+        void start();
+        void stop();
+    };
+}
@@ -0,0 +1,127 @@
+//
+//  Journal.cpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#include "Journal.hpp"
+#include "Logger.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sstream>
+
+namespace cc {
+    
+    // ----------------------------------------------------------------------
+    Journal::~Journal() {
+        close();
+    }
+    
+    // ----------------------------------------------------------------------
+    std::string Journal::defaultPath(const std::string& dir, const std::string& serial) {
+        return (dir.empty() ? "." : dir) + "/.canon-cli-" + (serial.empty() ? "camera" : serial) + ".journal";
+    }
+    
+    // ----------------------------------------------------------------------
+    void Journal::open(const std::string& path) {
+        close();
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if(fd < 0) {
+            Logger::getInstance()->warning("can't open journal "+path+": "+strerror(errno));
+            return;
+        }
+        
+        Header header;
+        ssize_t n = pread(fd, &header, sizeof(header), 0);
+        if(n == sizeof(header) && (header.magic != JOURNAL_MAGIC || header.version != JOURNAL_VERSION || header.entrySize != sizeof(JournalEntry))) {
+            Logger::getInstance()->warning("ignoring journal "+path+" from another version");
+            n = 0;
+        }
+        if(n != sizeof(header)) {
+            memset(&header, 0, sizeof(header));
+            header.magic = JOURNAL_MAGIC;
+            header.version = JOURNAL_VERSION;
+            header.entrySize = sizeof(JournalEntry);
+            if(ftruncate(fd, 0) < 0 || pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+                Logger::getInstance()->warning("can't write journal "+path+": "+strerror(errno));
+                close();
+                return;
+            }
+        }
+        
+        JournalEntry entry;
+        off_t offset = sizeof(Header);
+        while(pread(fd, &entry, sizeof(entry), offset) == sizeof(entry)) {
+            entries.push_back(entry);
+            offset += sizeof(entry);
+        }
+        
+        std::stringstream ss;
+        ss << "journal " << path << " has " << unfinished().size() << " unfinished downloads";
+        Logger::getInstance()->status(ss.str());
+    }
+    
+    // ----------------------------------------------------------------------
+    void Journal::close() {
+        if(fd >= 0) ::close(fd);
+        fd = -1;
+        entries.clear();
+    }
+    
+    // ----------------------------------------------------------------------
+    void Journal::write(int slot) {
+        if(fd < 0) return;
+        off_t offset = sizeof(Header) + (off_t)slot * sizeof(JournalEntry);
+        if(pwrite(fd, &entries[slot], sizeof(JournalEntry), offset) != sizeof(JournalEntry)) {
+            Logger::getInstance()->warning(std::string("can't write journal: ")+strerror(errno));
+            return;
+        }
+        if(sync) fsync(fd);
+    }
+    
+    // ----------------------------------------------------------------------
+    int Journal::add(const JournalEntry& entry) {
+        if(fd < 0) return -1;
+        int slot = 0;
+        while(slot < (int)entries.size() && entries[slot].pending) slot++;
+        if(slot == (int)entries.size()) entries.push_back(entry);
+        else entries[slot] = entry;
+        entries[slot].pending = 1;
+        write(slot);
+        return slot;
+    }
+    
+    // ----------------------------------------------------------------------
+    void Journal::update(int slot, const JournalEntry& entry) {
+        if(fd < 0 || slot < 0 || slot >= (int)entries.size()) return;
+        entries[slot] = entry;
+        entries[slot].pending = 1;
+        write(slot);
+    }
+    
+    // ----------------------------------------------------------------------
+    void Journal::remove(int slot) {
+        if(fd < 0 || slot < 0 || slot >= (int)entries.size()) return;
+        entries[slot].pending = 0;
+        write(slot);
+        
+        // Keep the file as small as what's in flight
+        while(!entries.empty() && !entries.back().pending) entries.pop_back();
+        if(ftruncate(fd, sizeof(Header) + entries.size() * sizeof(JournalEntry)) < 0) {
+            Logger::getInstance()->warning(std::string("can't trim journal: ")+strerror(errno));
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    std::vector<int> Journal::unfinished() {
+        std::vector<int> slots;
+        for(int i = 0; i < (int)entries.size(); i++) {
+            if(entries[i].pending) slots.push_back(i);
+        }
+        return slots;
+    }
+}
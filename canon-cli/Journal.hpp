@@ -0,0 +1,77 @@
+//
+//  Journal.hpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#define JOURNAL_MAGIC 0x4e4a4e43    // "CNJN"
+#define JOURNAL_VERSION 1
+
+namespace cc {
+    
+    // A download that has started but not been finalized. Enough to find the
+    // item on the card again and give it the same name
+    struct JournalEntry {
+        uint32_t pending;       // 0 for a free slot
+        uint32_t format;
+        uint64_t size;          // as the card reports it
+        uint32_t dateTime;
+        uint32_t reserved;
+        uint64_t seq;
+        int64_t epochMs;
+        int64_t durationMs;     // clips
+        char name[64];          // the camera's file name
+        char id[64];            // the request's "@id"
+        char request[256];      // name template given to "stop" or "picture"
+        char path[392];         // the name claimed for it, once there is one
+    };
+    
+    //
+    //  Downloads in flight, in a small file of fixed slots next to the
+    //  downloads: a slot is written when a transfer starts and freed when the
+    //  file is finalized. Anything still there at startup didn't make it, and
+    //  the session goes looking for it on the card.
+    //
+    class Journal {
+        
+    private:
+        struct Header {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t entrySize;
+            uint32_t reserved;
+        };
+        
+        int fd = -1;
+        std::vector<JournalEntry> entries;
+        
+        void write(int slot);
+        
+    public:
+        bool sync = false;      // fsync each change
+        
+        ~Journal();
+        
+        static std::string defaultPath(const std::string& dir, const std::string& serial);
+        
+        // Failure is logged; nothing is journaled then
+        void open(const std::string& path);
+        void close();
+        
+        // Returns the slot, or -1
+        int add(const JournalEntry& entry);
+        void update(int slot, const JournalEntry& entry);
+        void remove(int slot);
+        
+        // Slot numbers of unfinished downloads
+        std::vector<int> unfinished();
+        const JournalEntry& at(int slot) { return entries[slot]; }
+    };
+}
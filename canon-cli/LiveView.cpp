@@ -0,0 +1,317 @@
+//
+//  LiveView.cpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#include "LiveView.hpp"
+#include "Session.hpp"
+
+#include <stdio.h>
+#include <sstream>
+#include <algorithm>
+
+namespace cc {
+    
+    // ----------------------------------------------------------------------
+    LiveView::LiveView() :
+    demand(0),
+    followers(0),
+    waiting(0),
+    decodeDemand(0) {
+        for(int i=0; i<LIVEVIEW_SLOTS; ++i) {
+            streams[i] = NULL;
+            images[i] = NULL;
+            rgbStreams[i] = NULL;
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    LiveView::~LiveView() {
+        teardown();
+    }
+    
+    // ----------------------------------------------------------------------
+    // Wrap each slot's buffer in a memory stream and an evf image ref once, so
+    // pulling a frame allocates nothing.
+    void LiveView::setup() {
+        if(ready) return;
+        for(int i=0; i<LIVEVIEW_SLOTS; ++i) {
+            slots[i].data.resize(LIVEVIEW_FRAME_CAPACITY);
+            EDSDK_CHECK( EdsCreateMemoryStreamFromPointer(slots[i].data.data(), LIVEVIEW_FRAME_CAPACITY, &streams[i]) )
+            EDSDK_CHECK( EdsCreateEvfImageRef(streams[i], &images[i]) )
+        }
+        ready = true;
+        windowStart = steady_clock::now();
+        nextPoll = windowStart;
+    }
+    
+    // ----------------------------------------------------------------------
+    void LiveView::teardown() {
+        if(!ready) return;
+        for(int i=0; i<LIVEVIEW_SLOTS; ++i) {
+            if(images[i]) EdsRelease(images[i]);
+            if(streams[i]) EdsRelease(streams[i]);
+            if(rgbStreams[i]) EdsRelease(rgbStreams[i]);
+            images[i] = NULL;
+            streams[i] = NULL;
+            rgbStreams[i] = NULL;
+        }
+        ready = false;
+    }
+    
+    // ----------------------------------------------------------------------
+    void LiveView::retain() {
+        demand++;
+    }
+    
+    // ----------------------------------------------------------------------
+    void LiveView::release() {
+        if(demand > 0) demand--;
+    }
+    
+    // ----------------------------------------------------------------------
+    void LiveView::follow() {
+        followers++;
+    }
+    
+    // ----------------------------------------------------------------------
+    void LiveView::unfollow() {
+        if(followers > 0) followers--;
+    }
+    
+    // ----------------------------------------------------------------------
+    void LiveView::setBusy(bool b) {
+        busy = b;
+    }
+    
+    // ----------------------------------------------------------------------
+    void LiveView::retainDecoded() {
+        decodeDemand++;
+        retain();
+    }
+    
+    // ----------------------------------------------------------------------
+    void LiveView::releaseDecoded() {
+        if(decodeDemand > 0) {
+            decodeDemand--;
+            release();
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    void LiveView::setDecodeWidth(int w) {
+        decodeWidth = std::max(16, std::min(LIVEVIEW_DECODE_MAX_WIDTH, w));
+    }
+    
+    // ----------------------------------------------------------------------
+    void LiveView::setFps(double f) {
+        targetFps = std::max(0.5, std::min(60.0, f));
+        rate = targetFps;
+    }
+    
+    // ----------------------------------------------------------------------
+    steady_clock::duration LiveView::untilDue() {
+        if(!ready || !active()) return std::chrono::hours(1);
+        steady_clock::duration d = nextPoll - steady_clock::now();
+        return d < steady_clock::duration::zero() ? steady_clock::duration::zero() : d;
+    }
+    
+    // ----------------------------------------------------------------------
+    // A slot nobody holds. Only the latest slot can gain references (through
+    // latest() and wait()), and the ring holds one on it, so a zero count here
+    // can't go back up behind our back.
+    int LiveView::freeSlot() {
+        for(int i=1; i<=LIVEVIEW_SLOTS; ++i) {
+            int slot = (latestSlot + i) % LIVEVIEW_SLOTS;
+            if(slot != latestSlot && slots[slot].refs == 0) return slot;
+        }
+        return -1;
+    }
+    
+    // ----------------------------------------------------------------------
+    bool LiveView::update(EdsCameraRef camera) {
+        if(!ready || !active()) return false;
+        
+        steady_clock::time_point now = steady_clock::now();
+        if(now < nextPoll) return false;
+        
+        // Nobody would take a frame right now
+        if(demand == 0 && waiting == 0) {
+            skipped++;
+            nextPoll = now + std::chrono::milliseconds(LIVEVIEW_FOLLOW_CHECK);
+            return false;
+        }
+        
+        double limit = busy ? std::min(targetFps, (double)LIVEVIEW_BUSY_FPS) : targetFps;
+        rate = std::min(rate, limit);
+        nextPoll = now + std::chrono::microseconds((long long)(1000000 / rate));
+        
+        int slot = freeSlot();
+        if(slot < 0) {
+            dropped++;
+            return false;
+        }
+        
+        EdsSeek(streams[slot], 0, kEdsSeek_Begin);
+        EdsError err = EdsDownloadEvfImage(camera, images[slot]);
+        steady_clock::time_point done = steady_clock::now();
+        
+        if(err == EDS_ERR_OBJECT_NOTREADY) {
+            notReady++;
+            rate = std::max(std::min((double)LIVEVIEW_MIN_FPS, limit), rate * LIVEVIEW_BACKOFF);
+            nextPoll = now + std::chrono::microseconds((long long)(1000000 / rate));
+            return false;
+        }
+        if(err != EDS_ERR_OK) {
+            errors++;
+            Logger::getInstance()->warning("live view: "+Eds::getErrorString(err), LOG_SITE);
+            return false;
+        }
+        
+        EdsUInt64 size = 0;
+        EdsGetPosition(streams[slot], &size);
+        
+        Frame& frame = slots[slot];
+        frame.size = (size_t)size;
+        frame.timestamp = done;
+        frame.latency = std::chrono::duration<double, std::milli>(done - now).count();
+        frame.width = frame.height = 0;
+        if(decodeDemand > 0 && !decode(slot)) {
+            errors++;
+        }
+        publish(slot);
+        
+        frames++;
+        windowFrames++;
+        rate = std::min(limit, rate + LIVEVIEW_RAMP);
+        latency = frame.latency;
+        latencyAvg = latencyAvg == 0 ? latency : latencyAvg * 0.9 + latency * 0.1;
+        lastSize = frame.size;
+        double elapsed = std::chrono::duration<double>(done - windowStart).count();
+        if(elapsed >= 1.0) {
+            fps = windowFrames / elapsed;
+            windowFrames = 0;
+            windowStart = done;
+        }
+        return true;
+    }
+    
+    // ----------------------------------------------------------------------
+    // Let the SDK scale the JPEG down into the slot's RGB buffer. The RGB stream
+    // is made once per slot; the image ref has to be made per frame.
+    bool LiveView::decode(int slot) {
+        Frame& frame = slots[slot];
+        if(!rgbStreams[slot]) {
+            frame.rgb.resize(LIVEVIEW_DECODE_CAPACITY);
+            if(EdsCreateMemoryStreamFromPointer(frame.rgb.data(), LIVEVIEW_DECODE_CAPACITY, &rgbStreams[slot]) != EDS_ERR_OK) {
+                rgbStreams[slot] = NULL;
+                return false;
+            }
+        }
+        
+        EdsStreamRef jpeg = NULL;
+        EdsImageRef image = NULL;
+        EdsError err = EdsCreateMemoryStreamFromPointer(frame.data.data(), frame.size, &jpeg);
+        if(err == EDS_ERR_OK) err = EdsCreateImageRef(jpeg, &image);
+        
+        EdsImageInfo info;
+        if(err == EDS_ERR_OK) err = EdsGetImageInfo(image, kEdsImageSrc_FullView, &info);
+        if(err == EDS_ERR_OK && info.width > 0) {
+            EdsSize size;
+            size.width = decodeWidth;
+            size.height = (EdsInt32)((uint64_t)info.height * decodeWidth / info.width);
+            size.height = std::min(size.height, (EdsInt32)(LIVEVIEW_DECODE_CAPACITY / (decodeWidth*3)));
+            
+            EdsSeek(rgbStreams[slot], 0, kEdsSeek_Begin);
+            err = EdsGetImage(image, kEdsImageSrc_FullView, kEdsTargetImageType_RGB, info.effectiveRect, size, rgbStreams[slot]);
+            if(err == EDS_ERR_OK) {
+                frame.width = size.width;
+                frame.height = size.height;
+            }
+        }
+        
+        if(image) EdsRelease(image);
+        if(jpeg) EdsRelease(jpeg);
+        if(err != EDS_ERR_OK) {
+            Logger::getInstance()->warning("live view decode: "+Eds::getErrorString(err), LOG_SITE);
+            return false;
+        }
+        return frame.width > 0;
+    }
+    
+    // ----------------------------------------------------------------------
+    void LiveView::publish(int slot) {
+        std::lock_guard<std::mutex> lock(mutex);
+        slots[slot].sequence = ++sequence;
+        slots[slot].refs++;                                 // the ring's reference on the latest frame
+        if(latestSlot >= 0) slots[latestSlot].refs--;
+        latestSlot = slot;
+        cv.notify_all();
+    }
+    
+    // ----------------------------------------------------------------------
+    FrameRef LiveView::latest() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(latestSlot < 0) return FrameRef();
+        return FrameRef(&slots[latestSlot]);
+    }
+    
+    // ----------------------------------------------------------------------
+    FrameRef LiveView::wait(uint64_t after, std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex);
+        waiting++;
+        bool ready = cv.wait_for(lock, timeout, [&]{ return latestSlot >= 0 && slots[latestSlot].sequence > after; });
+        waiting--;
+        return ready ? FrameRef(&slots[latestSlot]) : FrameRef();
+    }
+    
+    // ----------------------------------------------------------------------
+    LiveViewStats LiveView::stats() {
+        LiveViewStats s;
+        s.active = active();
+        s.busy = busy;
+        s.fps = active() ? fps : 0;
+        s.targetFps = targetFps;
+        s.rate = rate;
+        s.consumers = demand;
+        s.followers = followers;
+        s.skipped = skipped;
+        s.latencyAvg = latencyAvg;
+        s.frames = frames;
+        s.dropped = dropped;
+        s.notReady = notReady;
+        s.errors = errors;
+        s.latency = latency;
+        s.lastSize = lastSize;
+        return s;
+    }
+    
+    // ----------------------------------------------------------------------
+    bool Region::parse(const std::string& spec) {
+        float r[4];
+        if(sscanf(spec.c_str(), "%f,%f,%f,%f", &r[0], &r[1], &r[2], &r[3]) != 4) return false;
+        if(r[0] < 0 || r[1] < 0 || r[2] <= 0 || r[3] <= 0 || r[0]+r[2] > 1.0001f || r[1]+r[3] > 1.0001f) return false;
+        x = r[0];
+        y = r[1];
+        w = r[2];
+        h = r[3];
+        return true;
+    }
+    
+    // ----------------------------------------------------------------------
+    std::string Region::toString() const {
+        std::stringstream ss;
+        ss << x << "," << y << "," << w << "," << h;
+        return ss.str();
+    }
+    
+    // ----------------------------------------------------------------------
+    void Region::pixels(int width, int height, int& x0, int& y0, int& x1, int& y1) const {
+        x0 = std::min(width, (int)(x * width));
+        y0 = std::min(height, (int)(y * height));
+        x1 = std::min(width, (int)((x+w) * width));
+        y1 = std::min(height, (int)((y+h) * height));
+    }
+}
@@ -0,0 +1,187 @@
+//
+//  LiveView.hpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#pragma once
+
+#define __MACOS__
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include "EDSDK.h"
+#include "EDSDKErrors.h"
+#include "EDSDKTypes.h"
+
+#define LIVEVIEW_SLOTS 8
+#define LIVEVIEW_FRAME_CAPACITY (1024*1024)  // evf JPEGs are a few hundred KB at most
+#define LIVEVIEW_DEFAULT_FPS 15
+#define LIVEVIEW_MIN_FPS 2                   // floor for NOTREADY back-off
+#define LIVEVIEW_BUSY_FPS 2                  // cap while the camera has files for us, so they get the bus
+#define LIVEVIEW_BACKOFF 0.75                // rate multiplier on EDS_ERR_OBJECT_NOTREADY
+#define LIVEVIEW_RAMP 0.5                    // fps added back per good frame
+#define LIVEVIEW_FOLLOW_CHECK 10             // ms between checks while every follower is still busy
+#define LIVEVIEW_DECODE_WIDTH 320            // decoded frames are for analysis, not display
+#define LIVEVIEW_DECODE_MAX_WIDTH 640
+#define LIVEVIEW_DECODE_CAPACITY (LIVEVIEW_DECODE_MAX_WIDTH*LIVEVIEW_DECODE_MAX_WIDTH*3)
+
+namespace cc {
+    
+    typedef std::chrono::steady_clock steady_clock;
+    
+    // One slot of the live view ring. The buffer is allocated once and the SDK
+    // downloads straight into it.
+    struct Frame {
+        std::vector<unsigned char> data;
+        size_t size = 0;
+        uint64_t sequence = 0;
+        steady_clock::time_point timestamp;
+        double latency = 0;         // ms spent in EdsDownloadEvfImage
+        std::vector<unsigned char> rgb;  // packed RGB, only while somebody wants decoded frames
+        int width = 0;              // of rgb. 0 when the frame wasn't decoded
+        int height = 0;
+        std::atomic<int> refs;
+        
+        Frame() : refs(0) {}
+    };
+    
+    // Counted handle on a frame. The ring won't reuse a slot while any handle on
+    // it is alive, so consumers on any thread can read the JPEG in place.
+    class FrameRef {
+    private:
+        Frame* frame;
+        
+    public:
+        FrameRef() : frame(NULL) {}
+        explicit FrameRef(Frame* f) : frame(f) { if(frame) frame->refs++; }
+        FrameRef(const FrameRef& other) : frame(other.frame) { if(frame) frame->refs++; }
+        FrameRef& operator=(FrameRef other) { std::swap(frame, other.frame); return *this; }
+        ~FrameRef() { if(frame) frame->refs--; }
+        
+        const Frame* operator->() const { return frame; }
+        const Frame& operator*() const { return *frame; }
+        explicit operator bool() const { return frame != NULL; }
+    };
+    
+    // Part of a frame, in fractions of its size, so it means the same thing at
+    // any decode width
+    struct Region {
+        float x = 0, y = 0, w = 1, h = 1;
+        
+        bool parse(const std::string& spec);    // "x,y,w,h"
+        std::string toString() const;
+        
+        // In pixels, [x0,x1) x [y0,y1), clamped to the frame
+        void pixels(int width, int height, int& x0, int& y0, int& x1, int& y1) const;
+    };
+    
+    struct LiveViewStats {
+        bool active;
+        bool busy;              // capped for downloads
+        double fps;             // achieved, over the last second
+        double targetFps;
+        double rate;            // what the loop is currently aiming for
+        int consumers;          // retain()
+        int followers;          // follow()
+        uint64_t frames;
+        uint64_t dropped;       // no free slot: every buffer was still held by a consumer
+        uint64_t notReady;      // EDS_ERR_OBJECT_NOTREADY
+        uint64_t errors;
+        uint64_t skipped;       // polls put off because no follower was ready for a frame
+        double latency;         // ms, last frame
+        double latencyAvg;      // ms, moving average
+        size_t lastSize;
+    };
+    
+    //
+    //  Pulls live view frames from the camera into a ring of preallocated buffers.
+    //  EDSDK calls stay on the session thread: Session::process() calls update(),
+    //  which downloads a frame whenever one is due. Consumers on other threads use
+    //  latest() or wait().
+    //
+    //  The rate adapts. It backs off multiplicatively when the camera answers
+    //  NOTREADY and climbs back a little with each good frame; it is capped at
+    //  LIVEVIEW_BUSY_FPS while the camera has files waiting to come down; and
+    //  when the only demand is followers (viewers that take frames as they're
+    //  ready for them), polls wait until at least one of them is waiting.
+    //
+    class LiveView {
+        
+    private:
+        Frame slots[LIVEVIEW_SLOTS];
+        EdsStreamRef streams[LIVEVIEW_SLOTS];
+        EdsEvfImageRef images[LIVEVIEW_SLOTS];
+        EdsStreamRef rgbStreams[LIVEVIEW_SLOTS];
+        bool ready = false;
+        
+        int latestSlot = -1;
+        uint64_t sequence = 0;
+        std::mutex mutex;
+        std::condition_variable cv;
+        
+        std::atomic<int> demand;
+        std::atomic<int> followers;
+        std::atomic<int> waiting;       // followers blocked in wait()
+        std::atomic<int> decodeDemand;
+        int decodeWidth = LIVEVIEW_DECODE_WIDTH;
+        double targetFps = LIVEVIEW_DEFAULT_FPS;
+        double rate = LIVEVIEW_DEFAULT_FPS;
+        bool busy = false;
+        steady_clock::time_point nextPoll;
+        
+        // metrics
+        uint64_t frames = 0, dropped = 0, notReady = 0, errors = 0, skipped = 0;
+        uint64_t windowFrames = 0;
+        steady_clock::time_point windowStart;
+        double fps = 0;
+        double latency = 0;
+        double latencyAvg = 0;
+        size_t lastSize = 0;
+        
+        int freeSlot();
+        bool decode(int slot);
+        void publish(int slot);
+        
+    public:
+        LiveView();
+        ~LiveView();
+        
+        // Session thread
+        void setup();
+        void teardown();
+        bool update(EdsCameraRef camera);
+        steady_clock::duration untilDue();
+        
+        // Polling only happens while somebody wants frames. retain() is for
+        // consumers that want every frame at the target rate; follow() for ones
+        // that pick frames up with wait() whenever they're ready.
+        void retain();
+        void release();
+        void follow();
+        void unfollow();
+        bool active() { return demand > 0 || followers > 0; }
+        
+        // Session thread: the camera has files for us. Keeps the rate down.
+        void setBusy(bool busy);
+        
+        // Also decode each frame to RGB at a reduced size, for analysis. Implies retain().
+        void retainDecoded();
+        void releaseDecoded();
+        void setDecodeWidth(int width);
+        
+        void setFps(double fps);
+        
+        LiveViewStats stats();
+        
+        // Any thread
+        FrameRef latest();
+        FrameRef wait(uint64_t after, std::chrono::milliseconds timeout); // newest frame with sequence > after
+    };
+}
@@ -7,29 +7,124 @@
 //
 
 #include "Logger.hpp"
+#include <chrono>
 
 cc::Logger* cc::Logger::instance = 0;
 
 namespace cc {
     
+    static const char* tags[] = { "[verbose] ", "[status] ", "[warning] ", "[error] " };
+    
+    static uint32_t hashMessage(const std::string& message) {
+        uint32_t h = 2166136261u;
+        for(char c : message) h = (h ^ (uint8_t)c) * 16777619u;
+        return h;
+    }
+    
     Logger* Logger::getInstance() {
         if (instance == 0) instance = new Logger();
         return instance;
     }
 
     void Logger::verbose(std::string message) {
-        if(level <= LOG_VERBOSE) std::cout << "[verbose] " << message << std::endl;
+        if(level <= LOG_VERBOSE) print(LOG_VERBOSE, message);
     }
     
     void Logger::status(std::string message)    {
-        if(level <= LOG_STATUS) std::cout << "[status] " << message << std::endl;
+        if(level <= LOG_STATUS) print(LOG_STATUS, message);
     }
     
     void Logger::warning(std::string message)   {
-        if(level <= LOG_WARNING) std::cout << "[warning] " << message << std::endl;
+        if(level <= LOG_WARNING) print(LOG_WARNING, message);
     }
     
     void Logger::error(std::string message)     {
-        if(level <= LOG_ERROR) std::cout << "[error] " << message << std::endl;
+        if(level <= LOG_ERROR) print(LOG_ERROR, message);
+    }
+    
+    void Logger::verbose(std::string message, uint32_t site) {
+        if(level <= LOG_VERBOSE) print(LOG_VERBOSE, message, site);
+    }
+    
+    void Logger::status(std::string message, uint32_t site)    {
+        if(level <= LOG_STATUS) print(LOG_STATUS, message, site);
+    }
+    
+    void Logger::warning(std::string message, uint32_t site)   {
+        if(level <= LOG_WARNING) print(LOG_WARNING, message, site);
+    }
+    
+    void Logger::error(std::string message, uint32_t site)     {
+        if(level <= LOG_ERROR) print(LOG_ERROR, message, site);
+    }
+    
+    // ----------------------------------------------------------------------
+    void Logger::print(int lvl, const std::string& message) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::cout << tags[lvl] << message << std::endl;
+    }
+    
+    // ----------------------------------------------------------------------
+    void Logger::print(int lvl, const std::string& message, uint32_t key) {
+        int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        uint32_t hash = hashMessage(message);
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        
+        // Open addressing on the call-site key. If the table is full the site just isn't limited.
+        Site* s = NULL;
+        for(int i=0; i<LOG_MAX_SITES; ++i) {
+            Site& slot = sites[(key + i) & (LOG_MAX_SITES-1)];
+            if(slot.key == key || slot.key == 0) {
+                s = &slot;
+                break;
+            }
+        }
+        if(s == NULL) {
+            std::cout << tags[lvl] << message << std::endl;
+            return;
+        }
+        if(s->key == 0) {
+            s->key = key;
+            s->level = lvl;
+            s->windowStart = now;
+        }
+        
+        if(now - s->windowStart >= window) {
+            if(s->repeated == 0 && s->suppressed == 0) s->last = 0; // site went quiet, start over
+            flush(*s);
+            s->windowStart = now;
+            s->printed = 0;
+        }
+        
+        if(hash == s->last) {
+            s->repeated++;
+            return;
+        }
+        if(s->printed >= burst) {
+            s->suppressed++;
+            return;
+        }
+        
+        flush(*s);
+        std::cout << tags[lvl] << message << std::endl;
+        s->last = hash;
+        s->printed++;
+    }
+    
+    // ----------------------------------------------------------------------
+    void Logger::flush(Site& s) {
+        if(s.repeated) std::cout << tags[s.level] << "last message repeated " << s.repeated << " times" << std::endl;
+        if(s.suppressed) std::cout << tags[s.level] << s.suppressed << " similar messages suppressed" << std::endl;
+        s.repeated = 0;
+        s.suppressed = 0;
+    }
+    
+    // ----------------------------------------------------------------------
+    void Logger::flush() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(Site& s : sites) {
+            if(s.key) flush(s);
+        }
     }
 }
@@ -10,28 +10,76 @@
 
 #include <iostream>
 #include <string>
+#include <mutex>
+#include <cstdint>
+#include <type_traits>
 
 #define LOG_VERBOSE 0
 #define LOG_STATUS 1
 #define LOG_WARNING 2
 #define LOG_ERROR 3
 
+// Hashed call-site key, folded at compile time. Pass it as the second argument
+// to a logging call to rate limit that line, eg:
+//   log->warning("can't execute commands while downloading", LOG_SITE);
+#define LOG_SITE (std::integral_constant<uint32_t, cc::Logger::site(__FILE__, __LINE__)>::value)
+
+#define LOG_MAX_SITES 64
+
 namespace cc {
     class Logger {
     private:
         static Logger* instance;
-        Logger() : level(LOG_WARNING) {
+        Logger() : level(LOG_WARNING), burst(5), window(1000) {
         
         }
         
+        struct Site {
+            uint32_t key = 0;           // call site, 0 = empty slot
+            uint32_t last = 0;          // hash of the last message printed from this site
+            uint32_t printed = 0;       // messages printed in the current window
+            uint32_t repeated = 0;      // copies of "last" swallowed since it was printed
+            uint32_t suppressed = 0;    // other messages dropped by the burst limit
+            int level = LOG_STATUS;
+            int64_t windowStart = 0;
+        };
+        Site sites[LOG_MAX_SITES];
+        std::mutex mutex;
+        
+        void print(int lvl, const std::string& message);
+        void print(int lvl, const std::string& message, uint32_t site);
+        void flush(Site& s);
+        
     public:
         
         static Logger* getInstance();
         
+        // FNV-1a over the file name, mixed with the line number.
+        static constexpr uint32_t site(const char* file, int line) {
+            uint32_t h = 2166136261u;
+            while(*file) h = (h ^ (uint8_t)*file++) * 16777619u;
+            h = (h ^ (uint32_t)line) * 16777619u;
+            return h ? h : 1;
+        }
+        
         int level;
+        uint32_t burst; // distinct messages a call site may print per window
+        int window;     // rate limiting window, in milliseconds
+        
         void verbose(std::string message);
         void status(std::string message);
         void warning(std::string message);
         void error(std::string message);
+        
+        // Rate limited versions: identical messages from the same site are collapsed
+        // into "last message repeated N times" and a site may print at most `burst`
+        // distinct messages per `window`.
+        void verbose(std::string message, uint32_t site);
+        void status(std::string message, uint32_t site);
+        void warning(std::string message, uint32_t site);
+        void error(std::string message, uint32_t site);
+        
+        // Print any pending repeat/suppression counts.
+        void flush();
     };
 }
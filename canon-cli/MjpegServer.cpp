@@ -0,0 +1,232 @@
+//
+//  MjpegServer.cpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#include "MjpegServer.hpp"
+#include "Logger.hpp"
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <string.h>
+#include <sstream>
+
+#ifdef MSG_NOSIGNAL
+#define MJPEG_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define MJPEG_SEND_FLAGS 0
+#endif
+
+namespace cc {
+    
+    static bool sendAll(int fd, const char* data, size_t size) {
+        while(size) {
+            ssize_t n = send(fd, data, size, MJPEG_SEND_FLAGS);
+            if(n < 0 && errno == EINTR) continue;
+            if(n <= 0) return false; // gone, or SO_SNDTIMEO expired
+            data += n;
+            size -= n;
+        }
+        return true;
+    }
+    
+    // ----------------------------------------------------------------------
+    MjpegServer::MjpegServer(LiveView* liveView, int port) :
+    liveView(liveView),
+    port(port),
+    running(false) {
+        
+    }
+    
+    // ----------------------------------------------------------------------
+    MjpegServer::~MjpegServer() {
+        stop();
+    }
+    
+    // ----------------------------------------------------------------------
+    void MjpegServer::start() {
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        if(listenFd < 0)
+            throw std::runtime_error(std::string("socket: ")+strerror(errno));
+        
+        int one = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if(bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+            throw std::runtime_error("bind port "+std::to_string(port)+": "+strerror(errno));
+        if(listen(listenFd, 16) < 0)
+            throw std::runtime_error(std::string("listen: ")+strerror(errno));
+        
+        std::stringstream ss;
+        ss << "live view on http://127.0.0.1:" << port << "/live.mjpg";
+        Logger::getInstance()->status(ss.str());
+        
+        running = true;
+        acceptor = std::thread(&MjpegServer::acceptLoop, this);
+    }
+    
+    // ----------------------------------------------------------------------
+    void MjpegServer::stop() {
+        if(!running) return;
+        running = false;
+        acceptor.join();
+        close(listenFd);
+        listenFd = -1;
+        
+        // Kick the viewers out of send() and wait for their threads to finish
+        std::unique_lock<std::mutex> lock(viewersMutex);
+        for(int fd : viewers) shutdown(fd, SHUT_RDWR);
+        viewersCv.wait(lock, [this]{ return viewers.empty(); });
+    }
+    
+    // ----------------------------------------------------------------------
+    void MjpegServer::acceptLoop() {
+        while(running) {
+            struct pollfd pfd = {listenFd, POLLIN, 0};
+            if(poll(&pfd, 1, 500) <= 0) continue;
+            
+            int fd = accept(listenFd, NULL, NULL);
+            if(fd < 0) continue;
+            
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+            setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+            struct timeval tv = {MJPEG_SEND_TIMEOUT, 0};
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            
+            std::unique_lock<std::mutex> lock(viewersMutex);
+            if(viewers.size() >= MJPEG_MAX_VIEWERS) {
+                lock.unlock();
+                const char* busy = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+                sendAll(fd, busy, strlen(busy));
+                close(fd);
+                continue;
+            }
+            viewers.insert(fd);
+            lock.unlock();
+            
+            std::thread(&MjpegServer::serve, this, fd).detach();
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    void MjpegServer::serve(int fd) {
+        // We only need the request line
+        std::string head;
+        char buf[1024];
+        while(head.find("\r\n\r\n") == std::string::npos && head.size() < 8192) {
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            if(n <= 0) break;
+            head.append(buf, n);
+        }
+        std::string method, path;
+        std::istringstream(head) >> method >> path;
+        
+        if(method.compare("GET")==0 && (path.compare("/live.mjpg")==0 || path.compare("/")==0)) {
+            stream(fd);
+        }
+        else if(method.compare("GET")==0 && path.compare("/frame.jpg")==0) {
+            liveView->follow();
+            FrameRef frame = liveView->wait(0, std::chrono::milliseconds(2000));
+            liveView->unfollow();
+            if(frame) {
+                sendFrame(fd, *frame, false);
+            } else {
+                const char* none = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+                sendAll(fd, none, strlen(none));
+            }
+        }
+        else {
+            const char* missing = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            sendAll(fd, missing, strlen(missing));
+        }
+        
+        close(fd);
+        std::lock_guard<std::mutex> lock(viewersMutex);
+        viewers.erase(fd);
+        viewersCv.notify_all();
+    }
+    
+    // ----------------------------------------------------------------------
+    void MjpegServer::stream(int fd) {
+        std::string header =
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: multipart/x-mixed-replace; boundary=" MJPEG_BOUNDARY "\r\n"
+            "Cache-Control: no-cache\r\n"
+            "Connection: close\r\n\r\n";
+        if(!sendAll(fd, header.data(), header.size())) return;
+        
+        Logger::getInstance()->status("live view viewer connected");
+        liveView->follow();
+        
+        uint64_t last = 0;
+        while(running) {
+            // Whatever is newest once we're ready. Frames that came and went while
+            // we were sending are simply skipped.
+            FrameRef frame = liveView->wait(last, std::chrono::milliseconds(1000));
+            if(!frame) continue;
+            last = frame->sequence;
+            if(!sendFrame(fd, *frame, true)) break;
+        }
+        
+        liveView->unfollow();
+        Logger::getInstance()->status("live view viewer disconnected");
+    }
+    
+    // ----------------------------------------------------------------------
+    bool MjpegServer::sendFrame(int fd, const Frame& frame, bool part) {
+        std::stringstream ss;
+        if(part) {
+            ss << "--" MJPEG_BOUNDARY "\r\n";
+        } else {
+            ss << "HTTP/1.1 200 OK\r\nConnection: close\r\n";
+        }
+        ss << "Content-Type: image/jpeg\r\n"
+           << "Content-Length: " << frame.size << "\r\n"
+           << "X-Frame-Sequence: " << frame.sequence << "\r\n\r\n";
+        std::string head = ss.str();
+        
+        // Header, the JPEG straight from the ring slot, and the part terminator
+        struct iovec iov[3];
+        iov[0].iov_base = (void*)head.data();
+        iov[0].iov_len = head.size();
+        iov[1].iov_base = (void*)frame.data.data();
+        iov[1].iov_len = frame.size;
+        iov[2].iov_base = (void*)"\r\n";
+        iov[2].iov_len = part ? 2 : 0;
+        
+        int count = 3;
+        struct iovec* v = iov;
+        while(count) {
+            ssize_t n = writev(fd, v, count);
+            if(n < 0 && errno == EINTR) continue;
+            if(n <= 0) return false;
+            while(count && (size_t)n >= v->iov_len) {
+                n -= v->iov_len;
+                v++;
+                count--;
+            }
+            if(count) {
+                v->iov_base = (char*)v->iov_base + n;
+                v->iov_len -= n;
+            }
+        }
+        return true;
+    }
+}
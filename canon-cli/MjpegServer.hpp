@@ -0,0 +1,60 @@
+//
+//  MjpegServer.hpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#pragma once
+
+#include <string>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "LiveView.hpp"
+
+#define MJPEG_MAX_VIEWERS (LIVEVIEW_SLOTS-2)  // each viewer pins at most one slot while sending
+#define MJPEG_SEND_TIMEOUT 2                 // seconds a viewer may block us before it's dropped
+#define MJPEG_BOUNDARY "canoncliframe"
+
+namespace cc {
+    
+    //
+    //  Serves live view on localhost as multipart/x-mixed-replace:
+    //
+    //    GET /live.mjpg    stream
+    //    GET /frame.jpg    latest frame
+    //
+    //  Every viewer sends straight out of the shared ring slots, no copies. A
+    //  viewer that falls behind just picks up the newest frame when it's ready
+    //  for another, so nothing queues up. The camera is only polled while at
+    //  least one viewer is connected.
+    //
+    class MjpegServer {
+        
+    private:
+        LiveView* liveView;
+        int port;
+        int listenFd = -1;
+        std::atomic<bool> running;
+        std::thread acceptor;
+        
+        std::set<int> viewers;
+        std::mutex viewersMutex;
+        std::condition_variable viewersCv;
+        
+        void acceptLoop();
+        void serve(int fd);
+        void stream(int fd);
+        bool sendFrame(int fd, const Frame& frame, bool part);
+        
+    public:
+        MjpegServer(LiveView* liveView, int port);
+        ~MjpegServer();
+        
+        void start();
+        void stop();
+    };
+}
@@ -0,0 +1,95 @@
+//
+//  MotionDetector.cpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#include "MotionDetector.hpp"
+#include "Simd.hpp"
+
+#include <string.h>
+#include <algorithm>
+
+namespace cc {
+    
+    // ----------------------------------------------------------------------
+    MotionDetector::MotionDetector() {
+        previous.reserve(LIVEVIEW_DECODE_CAPACITY);
+    }
+    
+    // ----------------------------------------------------------------------
+    void MotionDetector::reset() {
+        width = height = 0;
+        over = 0;
+    }
+    
+    // ----------------------------------------------------------------------
+    int MotionDetector::update(const Frame& frame) {
+        if(!enabled || frame.width == 0) return MOTION_NONE;
+        steady_clock::time_point start = steady_clock::now();
+        
+        int x0, y0, x1, y1;
+        roi.pixels(frame.width, frame.height, x0, y0, x1, y1);
+        if(x1 <= x0 || y1 <= y0) return MOTION_NONE;
+        
+        size_t stride = (size_t)frame.width * 3;
+        size_t row = (size_t)(x1-x0) * 3;
+        const uint8_t* src = frame.rgb.data() + y0*stride + x0*3;
+        
+        bool comparable = width == frame.width && height == frame.height
+            && std::chrono::duration<double>(frame.timestamp - lastFrame).count() < MOTION_MAX_GAP;
+        
+        if(comparable) {
+            uint64_t sum = 0;
+            for(int y=y0; y<y1; ++y) {
+                sum += simd::sad(src + (y-y0)*stride, previous.data() + (y-y0)*row, row);
+            }
+            score = (double)sum / (row * (y1-y0));
+        } else {
+            score = 0;
+        }
+        
+        // Keep this frame's ROI for the next comparison
+        previous.resize(row * (y1-y0));
+        for(int y=y0; y<y1; ++y) {
+            memcpy(previous.data() + (y-y0)*row, src + (y-y0)*stride, row);
+        }
+        width = frame.width;
+        height = frame.height;
+        lastFrame = frame.timestamp;
+        frames++;
+        
+        int result = MOTION_NONE;
+        if(score > threshold) {
+            over++;
+            lastMotion = frame.timestamp;
+            if(!moving && over >= MOTION_TRIGGER_FRAMES) {
+                moving = true;
+                result = MOTION_START;
+            }
+        } else {
+            over = 0;
+            if(score > threshold / 2) lastMotion = frame.timestamp;
+            if(moving && std::chrono::duration<double>(frame.timestamp - lastMotion).count() > hold) {
+                moving = false;
+                result = MOTION_STOP;
+            }
+        }
+        
+        processMs = std::chrono::duration<double, std::milli>(steady_clock::now() - start).count();
+        return result;
+    }
+    
+    // ----------------------------------------------------------------------
+    bool MotionDetector::setROI(const std::string& spec) {
+        if(!roi.parse(spec)) return false;
+        reset();
+        return true;
+    }
+    
+    // ----------------------------------------------------------------------
+    std::string MotionDetector::getROI() {
+        return roi.toString();
+    }
+}
@@ -0,0 +1,63 @@
+//
+//  MotionDetector.hpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "LiveView.hpp"
+
+#define MOTION_DEFAULT_THRESHOLD 8.0    // mean absolute difference per channel, 0-255
+#define MOTION_DEFAULT_HOLD 5.0         // seconds of stillness before stopping
+#define MOTION_TRIGGER_FRAMES 2         // consecutive frames over the threshold to start
+#define MOTION_MAX_GAP 1.0              // seconds. longer gaps (downloads) restart the comparison
+
+#define MOTION_NONE 0
+#define MOTION_START 1
+#define MOTION_STOP 2
+
+namespace cc {
+    
+    //
+    //  Frame differencing on decoded live view frames. Scores each frame by the
+    //  mean absolute difference from the previous one inside a region of
+    //  interest, and turns the scores into start/stop decisions with hysteresis:
+    //  start after MOTION_TRIGGER_FRAMES frames over the threshold, stop once
+    //  the score has stayed under half of it for the hold time.
+    //
+    class MotionDetector {
+        
+    private:
+        std::vector<uint8_t> previous;  // last frame's ROI, rows packed
+        int width = 0, height = 0;      // of the frame previous came from
+        steady_clock::time_point lastFrame;
+        steady_clock::time_point lastMotion;
+        int over = 0;
+        
+    public:
+        MotionDetector();
+        
+        bool enabled = false;
+        Region roi;
+        double threshold = MOTION_DEFAULT_THRESHOLD;
+        double hold = MOTION_DEFAULT_HOLD;
+        
+        // Last results
+        bool moving = false;
+        double score = 0;
+        double processMs = 0;
+        uint64_t frames = 0;
+        
+        // Session thread. Returns MOTION_START or MOTION_STOP when the state flips.
+        int update(const Frame& frame);
+        void reset();
+        
+        // "x,y,w,h" in fractions of the frame
+        bool setROI(const std::string& spec);
+        std::string getROI();
+    };
+}
@@ -0,0 +1,177 @@
+//
+//  PathTemplate.cpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#include "PathTemplate.hpp"
+
+#include <stdexcept>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+namespace cc {
+    
+    // Bounded appends into the render buffer. They keep counting past the end
+    // so render() can tell the path didn't fit.
+    static inline void appendText(char* buf, size_t& at, const char* s, size_t n) {
+        if(at + n < PATH_TEMPLATE_MAX) memcpy(buf + at, s, n);
+        at += n;
+    }
+    
+    static inline void appendNumber(char* buf, size_t& at, uint64_t v, int width) {
+        char digits[24];
+        int n = 0;
+        do {
+            digits[n++] = '0' + (v % 10);
+            v /= 10;
+        } while(v);
+        while(n < width && n < (int)sizeof(digits)) digits[n++] = '0';
+        for(int i=n-1; i>=0; --i) {
+            if(at + 1 < PATH_TEMPLATE_MAX) buf[at] = digits[i];
+            at++;
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    PathTemplate::PathTemplate() {
+        lastParent[0] = 0;
+        compile(PATH_TEMPLATE_DEFAULT);
+    }
+    
+    // ----------------------------------------------------------------------
+    PathTemplate::PathTemplate(const std::string& s) {
+        lastParent[0] = 0;
+        compile(s);
+    }
+    
+    // ----------------------------------------------------------------------
+    void PathTemplate::compile(const std::string& s) {
+        static const struct { const char* name; TokenType type; } fields[] = {
+            {"dir", DIR}, {"serial", SERIAL}, {"name", NAME}, {"ext", EXT}, {"index", INDEX},
+            {"seq", SEQ}, {"epoch", EPOCH}, {"epoch_ms", EPOCH_MS}, {"date", DATE}, {"time", TIME},
+        };
+        
+        std::string literals;
+        std::vector<Token> tokens;
+        size_t i = 0;
+        while(i < s.size()) {
+            size_t open = s.find('{', i);
+            size_t end = open == std::string::npos ? s.size() : open;
+            if(end > i) {
+                Token t = { TEXT, 0, (uint16_t)(end - i), (uint32_t)literals.size() };
+                literals.append(s, i, end - i);
+                tokens.push_back(t);
+            }
+            if(open == std::string::npos) break;
+            
+            size_t close = s.find('}', open);
+            if(close == std::string::npos)
+                throw std::runtime_error("unclosed { in name template "+s);
+            std::string field = s.substr(open+1, close-open-1);
+            int width = 0;
+            size_t colon = field.find(':');
+            if(colon != std::string::npos) {
+                width = atoi(field.c_str() + colon + 1);
+                field.erase(colon);
+            }
+            
+            bool known = false;
+            for(auto& f : fields) {
+                if(field.compare(f.name)==0) {
+                    Token t = { f.type, (uint8_t)std::min(width, 20), 0, 0 };
+                    tokens.push_back(t);
+                    known = true;
+                    break;
+                }
+            }
+            if(!known)
+                throw std::runtime_error("unknown field {"+field+"} in name template "+s);
+            i = close + 1;
+        }
+        if(literals.find('}') != std::string::npos)
+            throw std::runtime_error("stray } in name template "+s);
+        
+        spec = s;
+        text.swap(literals);
+        program.swap(tokens);
+    }
+    
+    // ----------------------------------------------------------------------
+    const char* PathTemplate::render(const PathVars& vars) {
+        size_t at = 0;
+        struct tm local;
+        bool haveTime = false;
+        
+        for(const Token& t : program) {
+            switch(t.type) {
+                case TEXT:      appendText(buffer, at, text.data() + t.offset, t.length); break;
+                case DIR:       appendText(buffer, at, vars.dir, strlen(vars.dir)); break;
+                case SERIAL:    appendText(buffer, at, vars.serial, strlen(vars.serial)); break;
+                case NAME:      appendText(buffer, at, vars.name, strlen(vars.name)); break;
+                case EXT:       appendText(buffer, at, vars.ext, strlen(vars.ext)); break;
+                case INDEX:     appendNumber(buffer, at, vars.index, t.width); break;
+                case SEQ:       appendNumber(buffer, at, vars.seq, t.width); break;
+                case EPOCH:     appendNumber(buffer, at, vars.epochMs / 1000, t.width); break;
+                case EPOCH_MS:  appendNumber(buffer, at, vars.epochMs, t.width); break;
+                case DATE:
+                case TIME:
+                    if(!haveTime) {
+                        time_t secs = (time_t)(vars.epochMs / 1000);
+                        localtime_r(&secs, &local);
+                        haveTime = true;
+                    }
+                    if(t.type == DATE) {
+                        appendNumber(buffer, at, local.tm_year + 1900, 4);
+                        appendText(buffer, at, "-", 1);
+                        appendNumber(buffer, at, local.tm_mon + 1, 2);
+                        appendText(buffer, at, "-", 1);
+                        appendNumber(buffer, at, local.tm_mday, 2);
+                    } else {
+                        appendNumber(buffer, at, local.tm_hour, 2);
+                        appendNumber(buffer, at, local.tm_min, 2);
+                        appendNumber(buffer, at, local.tm_sec, 2);
+                    }
+                    break;
+            }
+        }
+        
+        if(at >= PATH_TEMPLATE_MAX) {
+            size = 0;
+            buffer[0] = 0;
+            return NULL;
+        }
+        buffer[at] = 0;
+        size = at;
+        return buffer;
+    }
+    
+    // ----------------------------------------------------------------------
+    bool PathTemplate::makeParents() {
+        char* slash = strrchr(buffer, '/');
+        if(!slash || slash == buffer) return true;
+        
+        size_t n = slash - buffer;
+        if(strncmp(lastParent, buffer, n)==0 && lastParent[n]==0) return true;
+        
+        char path[PATH_TEMPLATE_MAX];
+        memcpy(path, buffer, n);
+        path[n] = 0;
+        for(char* p = path + 1; ; ++p) {
+            if(*p == '/' || *p == 0) {
+                char c = *p;
+                *p = 0;
+                if(mkdir(path, 0755) < 0 && errno != EEXIST) return false;
+                *p = c;
+                if(c == 0) break;
+            }
+        }
+        memcpy(lastParent, path, n+1);
+        return true;
+    }
+}
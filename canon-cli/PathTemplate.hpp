@@ -0,0 +1,75 @@
+//
+//  PathTemplate.hpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#define PATH_TEMPLATE_DEFAULT "{dir}/canon_{index}_{epoch_ms}_{seq}.{ext}"
+#define PATH_TEMPLATE_MAX 1024
+
+namespace cc {
+    
+    // What a template can refer to. Strings are borrowed, not copied.
+    struct PathVars {
+        const char* dir = ".";
+        const char* serial = "";
+        const char* name = "";      // the camera's own file name, without extension
+        const char* ext = "";
+        int32_t index = 0;          // camera index
+        uint64_t seq = 0;
+        int64_t epochMs = 0;        // capture time, ms since epoch
+    };
+    
+    //
+    //  Output file names like "{dir}/{serial}/{date}/{seq:06}_{epoch_ms}.{ext}".
+    //  The template is parsed once into a short token program; render() runs it
+    //  into a buffer owned by the template, so naming a file allocates nothing.
+    //
+    //    {dir} {serial} {name} {ext} {index} {seq} {epoch} {epoch_ms}
+    //    {date} YYYY-MM-DD, {time} HHMMSS, both local time
+    //    {seq:06}  numbers take a zero padded width
+    //
+    class PathTemplate {
+        
+    private:
+        enum TokenType : uint8_t { TEXT, DIR, SERIAL, NAME, EXT, INDEX, SEQ, EPOCH, EPOCH_MS, DATE, TIME };
+        
+        struct Token {
+            TokenType type;
+            uint8_t width;          // zero padding for numbers
+            uint16_t length;        // TEXT: bytes of text
+            uint32_t offset;        // TEXT: where in text
+        };
+        
+        std::string spec;
+        std::string text;           // literal parts, back to back
+        std::vector<Token> program;
+        char buffer[PATH_TEMPLATE_MAX];
+        size_t size = 0;
+        char lastParent[PATH_TEMPLATE_MAX];
+        
+    public:
+        PathTemplate();
+        explicit PathTemplate(const std::string& spec);
+        
+        // Throws std::runtime_error on unknown fields or unbalanced braces
+        void compile(const std::string& spec);
+        
+        // The rendered path, valid until the next render. NULL if it didn't fit.
+        const char* render(const PathVars& vars);
+        size_t length() const { return size; }
+        
+        // Create the directories above the last rendered path. Remembers the
+        // last one it made, so a run of files in one folder costs nothing.
+        bool makeParents();
+        
+        const std::string& source() const { return spec; }
+    };
+}
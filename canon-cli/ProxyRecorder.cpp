@@ -0,0 +1,261 @@
+//
+//  ProxyRecorder.cpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#include "ProxyRecorder.hpp"
+#include "Logger.hpp"
+
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <sstream>
+
+// Offsets of the header fields filled in once the file is complete
+#define AVI_RIFF_SIZE 4
+#define AVI_AVIH_TOTAL_FRAMES 48
+#define AVI_AVIH_WIDTH 64
+#define AVI_AVIH_HEIGHT 68
+#define AVI_STRH_LENGTH 140
+#define AVI_STRF_WIDTH 176
+#define AVI_STRF_HEIGHT 180
+#define AVI_MOVI_SIZE 216
+
+namespace cc {
+    
+    // Little endian writers; AVI is little endian everywhere
+    static void put32(FILE* f, uint32_t v) {
+        unsigned char b[4] = { (unsigned char)v, (unsigned char)(v>>8), (unsigned char)(v>>16), (unsigned char)(v>>24) };
+        fwrite(b, 1, 4, f);
+    }
+    
+    static void put16(FILE* f, uint16_t v) {
+        unsigned char b[2] = { (unsigned char)v, (unsigned char)(v>>8) };
+        fwrite(b, 1, 2, f);
+    }
+    
+    static void putFourcc(FILE* f, const char* fourcc) {
+        fwrite(fourcc, 1, 4, f);
+    }
+    
+    static void patch32(FILE* f, long at, uint32_t v) {
+        long here = ftell(f);
+        fseek(f, at, SEEK_SET);
+        put32(f, v);
+        fseek(f, here, SEEK_SET);
+    }
+    
+    // Frame size from the JPEG's SOF marker, if it has one
+    static bool jpegSize(const unsigned char* p, size_t n, int& width, int& height) {
+        size_t i = 2;
+        while(i+9 < n) {
+            if(p[i] != 0xFF) return false;
+            unsigned char marker = p[i+1];
+            size_t length = (p[i+2] << 8) | p[i+3];
+            if(marker >= 0xC0 && marker <= 0xC3) {
+                height = (p[i+5] << 8) | p[i+6];
+                width = (p[i+7] << 8) | p[i+8];
+                return true;
+            }
+            i += 2 + length;
+        }
+        return false;
+    }
+    
+    // ----------------------------------------------------------------------
+    ProxyRecorder::~ProxyRecorder() {
+        end();
+    }
+    
+    // ----------------------------------------------------------------------
+    bool ProxyRecorder::begin(const std::string& path, double f, steady_clock::time_point s) {
+        if(running) end();
+        
+        file = fopen(path.c_str(), "wb");
+        if(!file) {
+            Logger::getInstance()->warning("can't write proxy "+path+": "+strerror(errno));
+            return false;
+        }
+        setvbuf(file, NULL, _IOFBF, 1<<20);
+        
+        result = ProxyResult();
+        result.path = path;
+        overflowed = 0;
+        fps = f;
+        start = s;
+        width = height = 0;
+        index.clear();
+        writeHeaders();
+        
+        running = true;
+        thread = std::thread(&ProxyRecorder::run, this);
+        Logger::getInstance()->status("recording proxy to "+path);
+        return true;
+    }
+    
+    // ----------------------------------------------------------------------
+    void ProxyRecorder::push(const FrameRef& frame) {
+        if(!running || !frame || frame->timestamp < start) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        if(queue.size() >= PROXY_MAX_QUEUED) {
+            overflowed++;
+            return;
+        }
+        queue.push_back(frame);
+        cv.notify_one();
+    }
+    
+    // ----------------------------------------------------------------------
+    ProxyResult ProxyRecorder::end() {
+        if(!running) return result;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+            cv.notify_one();
+        }
+        thread.join();  // drains the queue and finalizes the file
+        result.dropped += overflowed;
+        
+        std::stringstream ss;
+        ss << "proxy " << result.path << ": " << result.frames << " frames, " << result.repeated << " repeated, " << result.dropped << " dropped";
+        Logger::getInstance()->status(ss.str());
+        return result;
+    }
+    
+    // ----------------------------------------------------------------------
+    void ProxyRecorder::run() {
+        bool failed = false;
+        while(true) {
+            FrameRef frame;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this]{ return !queue.empty() || !running; });
+                if(queue.empty()) break;
+                frame = queue.front();
+                queue.pop_front();
+            }
+            if(!failed && !writeFrame(*frame)) {
+                failed = true;
+                Logger::getInstance()->warning("proxy "+result.path+" stopped early");
+            }
+        }
+        finish();
+    }
+    
+    // ----------------------------------------------------------------------
+    bool ProxyRecorder::writeFrame(const Frame& frame) {
+        if(width == 0) jpegSize(frame.data.data(), frame.size, width, height);
+        
+        // Where this frame belongs on the fixed rate timeline
+        double t = std::chrono::duration<double>(frame.timestamp - start).count();
+        uint64_t slot = (uint64_t)llround(t * fps);
+        if(slot + 1 < result.frames) {
+            result.dropped++;       // more than a frame early. the one before already covers it
+            return true;
+        }
+        while(result.frames < slot) {
+            if(!writeChunk(NULL, 0)) return false;
+            result.repeated++;
+        }
+        return writeChunk(frame.data.data(), (uint32_t)frame.size);
+    }
+    
+    // ----------------------------------------------------------------------
+    bool ProxyRecorder::writeChunk(const unsigned char* data, uint32_t size) {
+        long at = ftell(file);
+        if(at + size + 8 > PROXY_MAX_BYTES) return false;
+        
+        putFourcc(file, "00dc");
+        put32(file, size);
+        if(size) fwrite(data, 1, size, file);
+        if(size & 1) fputc(0, file);
+        if(ferror(file)) return false;
+        
+        index.push_back(std::make_pair((uint32_t)(at - moviStart), size));
+        result.frames++;
+        result.bytes += size;
+        return true;
+    }
+    
+    // ----------------------------------------------------------------------
+    // RIFF AVI with one MJPG stream. Sizes, counts and the frame size are
+    // written as 0 and patched in finish().
+    void ProxyRecorder::writeHeaders() {
+        uint32_t usPerFrame = (uint32_t)(1000000 / fps);
+        
+        putFourcc(file, "RIFF"); put32(file, 0); putFourcc(file, "AVI ");
+        putFourcc(file, "LIST"); put32(file, 192); putFourcc(file, "hdrl");
+        
+        putFourcc(file, "avih"); put32(file, 56);
+        put32(file, usPerFrame);        // dwMicroSecPerFrame
+        put32(file, 0);                 // dwMaxBytesPerSec
+        put32(file, 0);                 // dwPaddingGranularity
+        put32(file, 0x10);              // dwFlags: AVIF_HASINDEX
+        put32(file, 0);                 // dwTotalFrames
+        put32(file, 0);                 // dwInitialFrames
+        put32(file, 1);                 // dwStreams
+        put32(file, LIVEVIEW_FRAME_CAPACITY); // dwSuggestedBufferSize
+        put32(file, 0);                 // dwWidth
+        put32(file, 0);                 // dwHeight
+        put32(file, 0); put32(file, 0); put32(file, 0); put32(file, 0);
+        
+        putFourcc(file, "LIST"); put32(file, 116); putFourcc(file, "strl");
+        putFourcc(file, "strh"); put32(file, 56);
+        putFourcc(file, "vids"); putFourcc(file, "MJPG");
+        put32(file, 0);                 // dwFlags
+        put16(file, 0); put16(file, 0); // wPriority, wLanguage
+        put32(file, 0);                 // dwInitialFrames
+        put32(file, 1000);              // dwScale
+        put32(file, (uint32_t)llround(fps * 1000)); // dwRate
+        put32(file, 0);                 // dwStart
+        put32(file, 0);                 // dwLength
+        put32(file, LIVEVIEW_FRAME_CAPACITY); // dwSuggestedBufferSize
+        put32(file, 0xFFFFFFFF);        // dwQuality
+        put32(file, 0);                 // dwSampleSize
+        put16(file, 0); put16(file, 0); put16(file, 0); put16(file, 0); // rcFrame
+        
+        putFourcc(file, "strf"); put32(file, 40);
+        put32(file, 40);                // biSize
+        put32(file, 0);                 // biWidth
+        put32(file, 0);                 // biHeight
+        put16(file, 1);                 // biPlanes
+        put16(file, 24);                // biBitCount
+        putFourcc(file, "MJPG");        // biCompression
+        put32(file, 0); put32(file, 0); put32(file, 0); put32(file, 0); put32(file, 0);
+        
+        putFourcc(file, "LIST"); put32(file, 0);
+        moviStart = ftell(file);
+        putFourcc(file, "movi");
+    }
+    
+    // ----------------------------------------------------------------------
+    void ProxyRecorder::finish() {
+        long moviEnd = ftell(file);
+        
+        putFourcc(file, "idx1");
+        put32(file, (uint32_t)(index.size() * 16));
+        for(auto& entry : index) {
+            putFourcc(file, "00dc");
+            put32(file, entry.second ? 0x10 : 0);   // AVIIF_KEYFRAME
+            put32(file, entry.first);
+            put32(file, entry.second);
+        }
+        long end = ftell(file);
+        
+        patch32(file, AVI_RIFF_SIZE, (uint32_t)(end - 8));
+        patch32(file, AVI_MOVI_SIZE, (uint32_t)(moviEnd - moviStart));
+        patch32(file, AVI_AVIH_TOTAL_FRAMES, (uint32_t)result.frames);
+        patch32(file, AVI_STRH_LENGTH, (uint32_t)result.frames);
+        patch32(file, AVI_AVIH_WIDTH, width);
+        patch32(file, AVI_AVIH_HEIGHT, height);
+        patch32(file, AVI_STRF_WIDTH, width);
+        patch32(file, AVI_STRF_HEIGHT, height);
+        
+        result.ok = !ferror(file);
+        result.duration = result.frames / fps;
+        fclose(file);
+        file = NULL;
+    }
+}
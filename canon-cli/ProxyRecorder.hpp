@@ -0,0 +1,78 @@
+//
+//  ProxyRecorder.hpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdio.h>
+#include "LiveView.hpp"
+
+#define PROXY_MAX_QUEUED 3                  // frames; each one pins a live view slot
+#define PROXY_MAX_BYTES 0x3FF00000          // stay under 1 GB, where plain AVI stops working
+
+namespace cc {
+    
+    struct ProxyResult {
+        std::string path;
+        uint64_t frames = 0;        // written, including repeats for gaps
+        uint64_t repeated = 0;      // empty chunks standing in for frames live view didn't deliver
+        uint64_t dropped = 0;       // frames the writer couldn't keep up with, or that came early
+        uint64_t bytes = 0;
+        double duration = 0;        // seconds
+        bool ok = false;
+    };
+    
+    //
+    //  Writes live view to an MJPEG AVI while the camera records, so there's
+    //  something to look at before the real clip has downloaded. The session
+    //  thread hands over frame refs; a writer thread writes the JPEGs straight
+    //  out of the ring. The queue is bounded: if the disk can't keep up, frames
+    //  are dropped rather than buffered.
+    //
+    //  AVI has a fixed frame rate, so frame n sits at n/fps seconds after the
+    //  record start. Late frames leave holes that are filled with empty chunks,
+    //  which players show as a repeat of the previous frame.
+    //
+    class ProxyRecorder {
+        
+    private:
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<FrameRef> queue;
+        uint64_t overflowed = 0;        // frames pushed onto a full queue. result is the writer's
+        bool running = false;
+        
+        FILE* file = NULL;
+        double fps = 0;
+        steady_clock::time_point start;
+        int width = 0, height = 0;
+        long moviStart = 0;
+        std::vector<std::pair<uint32_t, uint32_t>> index;  // offset from "movi", size
+        ProxyResult result;
+        
+        void run();
+        bool writeFrame(const Frame& frame);
+        bool writeChunk(const unsigned char* data, uint32_t size);
+        void writeHeaders();
+        void finish();
+        
+    public:
+        ~ProxyRecorder();
+        
+        // Session thread
+        bool begin(const std::string& path, double fps, steady_clock::time_point start);
+        void push(const FrameRef& frame);
+        ProxyResult end();
+        bool active() { return running; }
+    };
+}
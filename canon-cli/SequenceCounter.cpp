@@ -0,0 +1,90 @@
+//
+//  SequenceCounter.cpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#include "SequenceCounter.hpp"
+#include "Logger.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sstream>
+
+namespace cc {
+    
+    // ----------------------------------------------------------------------
+    SequenceCounter::SequenceCounter() {
+        memory.magic = SEQUENCE_MAGIC;
+        memory.version = SEQUENCE_VERSION;
+        memory.value = 0;
+    }
+    
+    // ----------------------------------------------------------------------
+    SequenceCounter::~SequenceCounter() {
+        close();
+    }
+    
+    // ----------------------------------------------------------------------
+    std::string SequenceCounter::defaultPath(const std::string& dir, const std::string& serial) {
+        return (dir.empty() ? "." : dir) + "/.canon-cli-" + (serial.empty() ? "camera" : serial) + ".seq";
+    }
+    
+    // ----------------------------------------------------------------------
+    void SequenceCounter::open(const std::string& p) {
+        close();
+        path = p;
+        
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if(fd < 0) {
+            Logger::getInstance()->warning("can't open sequence file "+path+": "+strerror(errno));
+            return;
+        }
+        struct stat st;
+        if(fstat(fd, &st) < 0 || ((size_t)st.st_size < sizeof(Data) && ftruncate(fd, sizeof(Data)) < 0)) {
+            Logger::getInstance()->warning("can't size sequence file "+path+": "+strerror(errno));
+            ::close(fd);
+            return;
+        }
+        void* m = mmap(NULL, sizeof(Data), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(m == MAP_FAILED) {
+            Logger::getInstance()->warning("can't map sequence file "+path+": "+strerror(errno));
+            return;
+        }
+        
+        data = (Data*)m;
+        if(data->magic != SEQUENCE_MAGIC || data->version != SEQUENCE_VERSION) {
+            data->value = 0;
+            data->version = SEQUENCE_VERSION;
+            data->magic = SEQUENCE_MAGIC;
+        }
+        
+        std::stringstream ss;
+        ss << "sequence " << data->value << " from " << path;
+        Logger::getInstance()->status(ss.str());
+    }
+    
+    // ----------------------------------------------------------------------
+    void SequenceCounter::close() {
+        if(!data) return;
+        msync(data, sizeof(Data), MS_ASYNC);
+        munmap(data, sizeof(Data));
+        data = NULL;
+    }
+    
+    // ----------------------------------------------------------------------
+    uint64_t SequenceCounter::next() {
+        return __atomic_add_fetch(data ? &data->value : &memory.value, 1, __ATOMIC_RELAXED);
+    }
+    
+    // ----------------------------------------------------------------------
+    uint64_t SequenceCounter::current() {
+        return __atomic_load_n(data ? &data->value : &memory.value, __ATOMIC_RELAXED);
+    }
+}
@@ -0,0 +1,50 @@
+//
+//  SequenceCounter.hpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#pragma once
+
+#include <string>
+#include <stdint.h>
+
+#define SEQUENCE_MAGIC 0x43414e53 // "CANS"
+#define SEQUENCE_VERSION 1
+
+namespace cc {
+    
+    //
+    //  The {seq} counter for one camera, kept in a small mmap'd file so numbers
+    //  keep going up across runs. Taking a number is an atomic add on the
+    //  mapping, no syscall. The kernel writes it back; if the machine dies
+    //  before it does, O_EXCL on the output file still catches the reuse.
+    //
+    class SequenceCounter {
+        
+    private:
+        struct Data {
+            uint32_t magic;
+            uint32_t version;
+            uint64_t value;
+        };
+        
+        Data* data = NULL;
+        Data memory;            // used when the file can't be mapped
+        std::string path;
+        
+    public:
+        SequenceCounter();
+        ~SequenceCounter();
+        
+        static std::string defaultPath(const std::string& dir, const std::string& serial);
+        
+        // Failure is logged, not thrown; numbers then start over in memory
+        void open(const std::string& path);
+        void close();
+        
+        uint64_t next();
+        uint64_t current();
+    };
+}
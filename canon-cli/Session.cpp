@@ -7,8 +7,18 @@
 //
 
 #include "Session.hpp"
+#include "Simd.hpp"
+#include "XXHash.hpp"
 #include "json.hpp"
 
+#include <set>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+
 using json = nlohmann::json;
 
 namespace cc {
@@ -18,13 +28,14 @@ namespace cc {
     // ----------------------------------------------------------------------
     Session::Session() :
     sdkInitialized(false),
+    sessionOpen(false),
+    lastProgress(-1),
+    maxDuration(-1),
+    downloading(false),
     deleteAfterDownload(false),
     saveToHost(false),
     overwrite(false),
-    cameraIndex(-1),
-    maxDuration(-1),
-    sessionOpen(false),
-    downloading(false) {
+    cameraIndex(-1) {
         cc::Logger::getInstance()->status("initializing SDK");
         EDSDK_CHECK( EdsInitializeSDK() );
         sdkInitialized = true;
@@ -35,6 +46,15 @@ namespace cc {
 
     // ----------------------------------------------------------------------
     Session::~Session() {
+        finalizer.flush();
+        liveView.teardown();
+        frameRing.close();
+        sequence.close();
+        for(auto& r : cardQueue) EdsRelease(r.first);
+        for(EdsStreamRef& stream : chunkStreams) {
+            if(stream) EdsRelease(stream);
+        }
+        
         Logger::getInstance()->status("ending session");
         if(sessionOpen)  EdsCloseSession(camera);
         sessionOpen = false;
@@ -71,6 +91,13 @@ namespace cc {
             j[i]["port"] = _info.szPortName;
             j[i]["reserved"] = _info.reserved;
             
+            // Don't open and close our own camera out from under the session
+            if(sessionOpen && i == cameraIndex) {
+                j[i]["body"] = getSerial();
+                EDSDK_CHECK ( EdsRelease(_camera) )
+                continue;
+            }
+            
             EDSDK_CHECK( EdsOpenSession(_camera) )
             EdsDataType dataType;
             EdsUInt32 dataSize;
@@ -85,6 +112,74 @@ namespace cc {
         return j.dump(4);
     }
 
+    // ----------------------------------------------------------------------
+    // Send an event for a request to whoever issued it
+    static void emit(const request& req, const std::string& event, json j = json::object()) {
+        if(!req.respond) return;
+        if(!req.id.empty()) j["id"] = req.id;
+        j["command"] = req.cmd.size() ? req.cmd[0] : "";
+        j["event"] = event;
+        req.respond(j.dump());
+    }
+
+    // ----------------------------------------------------------------------
+    // Take a name by creating it empty. The data arrives later as "<name>.part"
+    static bool claimPath(const char* path) {
+        int fd = ::open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if(fd < 0) return false;
+        ::close(fd);
+        return true;
+    }
+    
+    // ----------------------------------------------------------------------
+    static bool emptyFile(const std::string& path) {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode) && st.st_size == 0;
+    }
+    
+    // ----------------------------------------------------------------------
+    // Throw away a download that won't be finalized, and the name it claimed
+    static void discard(TeeTarget& t) {
+        if(t.fd >= 0) ::close(t.fd);
+        if(!t.part.empty()) unlink(t.part.c_str());
+        if(t.placeholder) unlink(t.path.c_str());
+        t.fd = -1;
+        t.part.clear();
+        t.placeholder = false;
+    }
+    
+    // ----------------------------------------------------------------------
+    // Names given to "stop" and "picture" are templates relative to the default
+    // directory, checked now so a typo fails the command rather than the download
+    static std::string requestedPath(const std::string& name) {
+        std::string spec = name.at(0)=='/' ? name : "{dir}/"+name;
+        PathTemplate check(spec);
+        return spec;
+    }
+    
+    // ----------------------------------------------------------------------
+    // Epoch milliseconds, or a local "2026-10-18" / "2026-10-18T14:30:00"
+    static bool parseTime(const std::string& s, int64_t& out) {
+        if(!s.empty() && s.find_first_not_of("0123456789") == std::string::npos) {
+            errno = 0;
+            long long ms = strtoll(s.c_str(), NULL, 10);
+            if(errno == ERANGE) return false;
+            out = ms;
+            return true;
+        }
+        struct tm t;
+        memset(&t, 0, sizeof(t));
+        const char* end = strptime(s.c_str(), "%Y-%m-%dT%H:%M:%S", &t);
+        if(!end || *end) {
+            memset(&t, 0, sizeof(t));
+            end = strptime(s.c_str(), "%Y-%m-%d", &t);
+        }
+        if(!end || *end) return false;
+        t.tm_isdst = -1;
+        out = (int64_t)mktime(&t) * 1000;
+        return true;
+    }
+    
     // ----------------------------------------------------------------------
     EdsError Session::download(EdsBaseRef object) {
         downloading = true;
@@ -94,53 +189,671 @@ namespace cc {
         
         EDSDK_CHECK( EdsGetDirectoryItemInfo(directoryItem, &directoryItemInfo) )
         
+        // Streams over the tee's buffers, made before anything is opened that
+        // a failure here would leave behind
+        if(!chunkStreams[0]) {
+            for(int i = 0; i < TEE_BUFFERS; i++) {
+                EDSDK_CHECK( EdsCreateMemoryStreamFromPointer(tee.buffer(i), tee.capacity(), &chunkStreams[i]) )
+            }
+        }
+        
         std::stringstream ss;
         ss << "file size " << (directoryItemInfo.size / 1000000.0) << " mb";
         cc::Logger::getInstance()->status(ss.str());
         
-        // Make a default output name if one wasn't provided in the "stop" command
-        if(outfile.empty()) {
-            time_t epoch_time = std::time(0);
-            
-            ss.str("");
-            ss << defaultDir << "/canon_" << cameraIndex << "_"  << epoch_time;
-            
-            if (directoryItemInfo.format == EDSDK_MOV_FORMAT) {
-                ss << ".mp4";
+        std::string outfile;
+        
+        // The camera's name, split up for the template
+        char name[sizeof(directoryItemInfo.szFileName)];
+        char ext[sizeof(directoryItemInfo.szFileName)];
+        strncpy(name, directoryItemInfo.szFileName, sizeof(name)-1);
+        name[sizeof(name)-1] = 0;
+        char* dot = strrchr(name, '.');
+        if (directoryItemInfo.format == EDSDK_MOV_FORMAT) {
+            strcpy(ext, "mp4");
+        }
+        else if(directoryItemInfo.format == EDSDK_JPG_FORMAT) {
+            strcpy(ext, "jpg");
+        }
+        else {
+            cc::Logger::getInstance()->warning("unknown file type");
+            strcpy(ext, dot ? dot+1 : "bin");
+            for(char* c = ext; *c; ++c) *c = tolower(*c);
+        }
+        if(dot) *dot = 0;
+        
+        if(current.seq == 0) {
+            current.seq = sequence.next();
+            if(current.epochMs == 0) current.epochMs = StatusPage::now();
+        }
+        
+        // Journaled until it's finalized, so a crash from here on gets picked up at the next start
+        JournalEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.format = directoryItemInfo.format;
+        entry.size = directoryItemInfo.size;
+        entry.dateTime = directoryItemInfo.dateTime;
+        entry.seq = current.seq;
+        entry.epochMs = current.epochMs;
+        if(current.started != time_point()) {
+            entry.durationMs = std::chrono::duration_cast<milliseconds>(current.stopped - current.started).count();
+        }
+        Catalog::copy(entry.name, directoryItemInfo.szFileName, sizeof(entry.name));
+        Catalog::copy(entry.id, current.req.id, sizeof(entry.id));
+        Catalog::copy(entry.request, current.path, sizeof(entry.request));
+        bool resumed = current.journalSlot >= 0;
+        if(resumed) journal.update(current.journalSlot, entry);
+        else current.journalSlot = journal.add(entry);
+        
+        // Names are claimed with O_EXCL rather than checked with stat first, so
+        // another process (or another of our own captures) can't slip in between.
+        // The claim is an empty file; the data goes to "<name>.part" and replaces
+        // it once it's all there, so a crash never leaves a short file under a
+        // real name. A name given to "stop" or "picture" wins, unless it's taken
+        // and we mustn't overwrite
+        const char* path = NULL;
+        bool claimed = false;       // the name is ours
+        bool placeholder = false;   // and we made the empty file holding it
+        PathTemplate requested;
+        PathTemplate* used = &pathTemplate;
+        if(!current.path.empty()) {
+            try {
+                requested.compile(current.path);
+                path = renderPath(requested, ext, name, current.seq, current.epochMs);
+                if(path) {
+                    // With --overwrite the old file stays until the new one replaces it
+                    claimed = overwrite || claimPath(path);
+                    placeholder = claimed && !overwrite;
+                    if(claimed) {
+                        used = &requested;
+                    } else if(errno == EEXIST) {
+                        Logger::getInstance()->warning(std::string(path) + " already exists. using default name instead");
+                    } else {
+                        Logger::getInstance()->warning("can't create "+std::string(path)+": "+strerror(errno)+". using default name instead");
+                    }
+                }
+            } catch(std::runtime_error e) {
+                Logger::getInstance()->warning(std::string(e.what())+". using default name instead");
             }
-            else if(directoryItemInfo.format == EDSDK_JPG_FORMAT) {
-                ss << ".jpg";
+        }
+        for(int attempt = 0; !claimed && attempt < DOWNLOAD_NAME_ATTEMPTS; attempt++) {
+            if(attempt > 0) current.seq = sequence.next();
+            path = renderPath(pathTemplate, ext, name, current.seq, current.epochMs);
+            if(!path) throw std::runtime_error("output path too long for "+pathTemplate.source());
+            claimed = placeholder = claimPath(path);
+            if(!claimed && errno != EEXIST) break;
+        }
+        outfile = path;
+        std::string part = outfile + FINALIZE_PART_SUFFIX;
+        int fd = claimed ? ::open(part.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644) : -1;
+        if(fd < 0) {
+            std::string message = "can't create "+(claimed ? part : outfile)+": "+strerror(errno);
+            if(placeholder) unlink(outfile.c_str());
+            cc::Logger::getInstance()->error(message);
+            reportError(message);
+            json failed;
+            failed["path"] = outfile;
+            failed["message"] = message;
+            if(!current.job) failed["done"] = true;
+            emit(current.req, "error", failed);
+            EdsDownloadCancel(directoryItem);
+            settle(current, false, 0);
+            current = capture();
+            downloading = false;
+            publishState();
+            EDSDK_CHECK( EdsRelease(object) )
+            return EDS_ERR_OK;
+        }
+        
+        Catalog::copy(entry.path, outfile, sizeof(entry.path));
+        journal.update(current.journalSlot, entry);
+        
+        std::vector<TeeTarget> targets(1);
+        targets[0].path = outfile;
+        targets[0].part = part;
+        targets[0].fd = fd;
+        targets[0].placeholder = placeholder;
+        
+        // The same name under each --mirror folder. A copy that can't be made
+        // doesn't stop the others
+        for(const std::string& dir : mirrors) {
+            TeeTarget t;
+            const char* p = renderPath(*used, ext, name, current.seq, current.epochMs, dir.c_str());
+            if(p && outfile.compare(p)==0) {
+                // An absolute name given to "stop" or "picture". Keep just the file name
+                t.path = dir + outfile.substr(outfile.rfind('/'));
+            } else if(p) {
+                t.path = p;
             }
-            else {
-                cc::Logger::getInstance()->warning("unknown file type");
+            if(t.path.empty()) {
+                t.error = "output path too long";
+            } else if(!overwrite && !claimPath(t.path.c_str()) && !(resumed && errno == EEXIST && emptyFile(t.path))) {
+                // (an empty file left by the run a resumed download was interrupted in is ours)
+                t.error = errno == EEXIST ? "already exists" : strerror(errno);
+            } else {
+                t.placeholder = !overwrite;
+                t.part = t.path + FINALIZE_PART_SUFFIX;
+                t.fd = ::open(t.part.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                if(t.fd < 0) {
+                    t.error = strerror(errno);
+                    if(t.placeholder) unlink(t.path.c_str());
+                    t.part.clear();
+                    t.placeholder = false;
+                }
             }
-            outfile = ss.str();
+            targets.push_back(t);
         }
         
         cc::Logger::getInstance()->status("downloading "+outfile);
+        StatusData* status = statusPage.begin();
+        status->state = STATUS_DOWNLOADING;
+        StatusPage::copy(status->currentFile, outfile, sizeof(status->currentFile));
+        status->bytesDownloaded = 0;
+        status->bytesTotal = directoryItemInfo.size;
+        statusPage.end();
         
-        EdsStreamRef outStream;
-        EDSDK_CHECK( EdsCreateFileStream(outfile.c_str(), kEdsFileCreateDisposition_CreateAlways, kEdsAccess_ReadWrite, &outStream) )
-        EdsDownload(directoryItem, directoryItemInfo.size, outStream);
-        EdsDownloadComplete(directoryItem);
+        // A preview is there in a moment, long before a big clip is. Not for
+        // ingests, which are after the bus rate instead
+        if(thumbnails && !current.job) {
+            std::string thumbnail = saveThumbnail(directoryItem, outfile);
+            if(!thumbnail.empty()) {
+                json j;
+                j["path"] = thumbnail;
+                j["for"] = outfile;
+                emit(current.req, "thumbnail", j);
+            }
+        }
         
-        cc::Logger::getInstance()->status("releasing data stream");
-        EDSDK_CHECK( EdsRelease(outStream) )
+        json started;
+        started["path"] = outfile;
+        started["size"] = directoryItemInfo.size;
+        if(targets.size() > 1) {
+            started["mirrors"] = json::array();
+            for(size_t i = 1; i < targets.size(); i++) started["mirrors"].push_back(targets[i].path);
+        }
+        emit(current.req, "download-started", started);
         
-        //  Delete file after download
-        if(deleteAfterDownload) {
-            cc::Logger::getInstance()->status("deleting file from device");
-            EDSDK_CHECK( EdsDeleteDirectoryItem(directoryItem) )
+        // Pull the file over in chunks and hand each to the tee, which writes it
+        // to every .part file on its own threads while the next chunk comes in.
+        // EDSDK carries on from where the last EdsDownload left off until
+        // EdsDownloadComplete.
+        lastProgress = -1;
+        tee.begin(targets);
+        EdsError err = EDS_ERR_OK;
+        bool written = true;
+        XXHash64 hasher;
+        EdsUInt64 remaining = directoryItemInfo.size;
+        while(remaining > 0) {
+            EdsUInt64 n = std::min<EdsUInt64>(remaining, tee.capacity());
+            int i = tee.acquire();
+            EdsSeek(chunkStreams[i], 0, kEdsSeek_Begin);
+            time_point pulled = high_resolution_clock::now();
+            err = EdsDownload(directoryItem, n, chunkStreams[i]);
+            if(current.job) current.job->transferSeconds += std::chrono::duration<double>(high_resolution_clock::now() - pulled).count();
+            if(err != EDS_ERR_OK) break;
+            
+            hasher.update(tee.buffer(i), n);
+            tee.commit(i, n);
+            if(tee.healthy() == 0) {
+                written = false;
+                break;
+            }
+            remaining -= n;
+            handleProgress((EdsUInt32)(100 - remaining * 100 / directoryItemInfo.size));
+        }
+        targets = tee.end();
+        if(err == EDS_ERR_OK && written) {
+            EdsDownloadComplete(directoryItem);
+        } else {
+            EdsDownloadCancel(directoryItem);
         }
         
-        cc::Logger::getInstance()->status("downloaded "+outfile);
+        if(err != EDS_ERR_OK || !written) {
+            std::string message = err != EDS_ERR_OK ? Eds::getErrorString(err) : targets[0].error;
+            for(TeeTarget& t : targets) discard(t);
+            cc::Logger::getInstance()->error("download failed: "+message);
+            reportError("download of "+outfile+" failed: "+message);
+            json failed;
+            failed["path"] = outfile;
+            failed["message"] = message;
+            if(!current.job) failed["done"] = true;
+            emit(current.req, "error", failed);
+            settle(current, false, 0);
+        } else {
+            // Mirrors first, so their events come before the primary's "done".
+            // Reported (and deleted from the card) only once the policy says it's safe
+            std::shared_ptr<mirrorResult> mirrored = std::make_shared<mirrorResult>();
+            for(size_t i = 1; i < targets.size(); i++) {
+                finalizeMirror(current.req, targets[i], mirrored);
+            }
+            
+            TeeTarget& primary = targets[0];
+            if(!primary.error.empty()) {
+                discard(primary);
+                std::string message = "download of "+outfile+" failed: "+primary.error;
+                cc::Logger::getInstance()->error(message);
+                reportError(message);
+                json failed;
+                failed["path"] = outfile;
+                failed["message"] = message;
+                if(!current.job) failed["done"] = true;
+                emit(current.req, "error", failed);
+                settle(current, false, 0);
+            } else {
+                disk.consumed(directoryItemInfo.size);
+                capture done = current;
+                uint64_t hash = hasher.digest();
+                EdsRetain(directoryItem);
+                finalizer.submit(primary.fd, primary.part, outfile, [this, done, directoryItem, directoryItemInfo, outfile, hash, mirrored](const std::string& error) {
+                    finishDownload(done, directoryItem, directoryItemInfo, outfile, hash, mirrored, error);
+                });
+            }
+        }
         
-        outfile = "";
+        current = capture();
         downloading = false;
+        publishState();
         
         EDSDK_CHECK( EdsRelease(object) )
         return EDS_ERR_OK;
     }
+    
+    // ----------------------------------------------------------------------
+    // A download is under its final name (or failed to get there)
+    void Session::finishDownload(const capture& cap, EdsDirectoryItemRef item, const EdsDirectoryItemInfo& info, const std::string& path, uint64_t hash, std::shared_ptr<mirrorResult> mirrored, const std::string& error) {
+        EdsUInt64 size = info.size;
+        if(!error.empty()) {
+            std::string message = "can't finalize "+path+": "+error;
+            cc::Logger::getInstance()->error(message);
+            reportError(message);
+            json failed;
+            failed["path"] = path;
+            failed["message"] = message;
+            if(!cap.job) failed["done"] = true;
+            emit(cap.req, "error", failed);
+            EdsRelease(item);
+            settle(cap, false, 0);
+            return;
+        }
+        
+        //  Delete file after download, as long as every copy made it
+        if(deleteAfterDownload && mirrored->failed > 0) {
+            cc::Logger::getInstance()->warning("leaving "+path+" on the card: a mirror copy failed");
+        } else if(deleteAfterDownload) {
+            cc::Logger::getInstance()->status("deleting file from device");
+            EdsError err = EdsDeleteDirectoryItem(item);
+            if(err != EDS_ERR_OK) {
+                cc::Logger::getInstance()->warning("can't delete "+path+" from the card: "+Eds::getErrorString(err));
+            }
+        }
+        EdsRelease(item);
+        
+        journal.remove(cap.journalSlot);
+        if(!cap.folder.empty()) synced.add(cap.folder, info.szFileName, info.size, info.dateTime);
+        
+        cc::Logger::getInstance()->status("downloaded "+path);
+        json finalized;
+        finalized["path"] = path;
+        finalized["size"] = size;
+        finalized["hash"] = XXHash64::hex(hash);
+        if(!mirrored->paths.empty()) finalized["mirrors"] = mirrored->paths;
+        int64_t durationMs = 0;
+        if(cap.started != time_point()) {
+            durationMs = std::chrono::duration_cast<milliseconds>(cap.stopped - cap.started).count();
+        }
+        finalized["duration"] = durationMs / 1000.0;
+        if(!cap.job) finalized["done"] = true;
+        emit(cap.req, "finalized", finalized);
+        if(info.format == EDSDK_MOV_FORMAT) disk.learn(size, durationMs / 1000.0);
+        reportCapacity();
+        
+        CatalogRecord record;
+        memset(&record, 0, sizeof(record));
+        record.format = info.format;
+        record.size = size;
+        record.hash = hash;
+        record.seq = cap.seq;
+        record.started = cap.epochMs;
+        record.stopped = cap.epochMs + durationMs;
+        record.finalized = StatusPage::now();
+        Catalog::copy(record.serial, serial, sizeof(record.serial));
+        Catalog::copy(record.id, cap.req.id, sizeof(record.id));
+        Catalog::copy(record.path, path, sizeof(record.path));
+        catalog.append(record);
+        
+        StatusData* status = statusPage.begin();
+        status->captures++;
+        status->downloadedTotal += size;
+        statusPage.end();
+        
+        settle(cap, true, size);
+    }
+    
+    // ----------------------------------------------------------------------
+    // Count a finished (or failed) file against its "ingest"
+    void Session::settle(const capture& cap, bool ok, uint64_t bytes) {
+        if(!cap.job) return;
+        if(ok) cap.job->finished++;
+        else cap.job->failed++;
+        cap.job->done += bytes;
+        reportIngest(*cap.job);
+    }
+    
+    // ----------------------------------------------------------------------
+    // How far an "ingest" has got, and throughput: overall, and while the bus was busy
+    static json ingestStats(const ingestJob& job) {
+        time_point end = job.ended != time_point() ? job.ended : high_resolution_clock::now();
+        double elapsed = std::chrono::duration<double>(end - job.started).count();
+        double rate = elapsed > 0 ? job.done / elapsed : 0;
+        json j;
+        j["files"] = job.finished + job.failed;
+        j["of"] = job.files;
+        j["failed"] = job.failed;
+        j["bytes"] = job.done;
+        j["ofBytes"] = job.bytes;
+        j["seconds"] = elapsed;
+        j["rate"] = rate / 1000000;
+        j["busRate"] = job.transferSeconds > 0 ? job.done / job.transferSeconds / 1000000 : 0;
+        if(rate > 0 && job.done < job.bytes) j["eta"] = (job.bytes - job.done) / rate;
+        j["canceled"] = job.canceled;
+        return j;
+    }
+    
+    // ----------------------------------------------------------------------
+    // Tell the request how far along it is, and that it's done after the last file
+    void Session::reportIngest(ingestJob& job) {
+        json j = ingestStats(job);
+        if(job.finished + job.failed < job.files) {
+            emit(job.req, "ingest-progress", j);
+            return;
+        }
+        job.ended = high_resolution_clock::now();
+        
+        std::stringstream ss;
+        ss << "ingested " << job.finished << " files, " << job.done/1000000 << " MB in " << (int)j["seconds"].get<double>() << " s";
+        if(job.failed) ss << ". " << job.failed << " failed";
+        Logger::getInstance()->status(ss.str());
+        j["done"] = true;
+        emit(job.req, "ingest-finished", j);
+    }
+    
+    // ----------------------------------------------------------------------
+    // Write the camera's thumbnail of an item next to where its download is going,
+    // as "<name>.thumb.jpg". Returns the path, or empty if there isn't one
+    std::string Session::saveThumbnail(EdsDirectoryItemRef item, const std::string& path) {
+        size_t dot = path.rfind('.');
+        size_t slash = path.rfind('/');
+        std::string thumbnail = (dot == std::string::npos || (slash != std::string::npos && dot < slash) ? path : path.substr(0, dot)) + THUMBNAIL_SUFFIX;
+        
+        EdsStreamRef stream = NULL;
+        EdsError err = EdsCreateMemoryStream(0, &stream);
+        if(err == EDS_ERR_OK) err = EdsDownloadThumbnail(item, stream);
+        void* data = NULL;
+        EdsUInt64 length = 0;
+        if(err == EDS_ERR_OK) err = EdsGetPointer(stream, &data);
+        if(err == EDS_ERR_OK) err = EdsGetLength(stream, &length);
+        if(err != EDS_ERR_OK || length == 0) {
+            Logger::getInstance()->warning("no thumbnail for "+path+(err != EDS_ERR_OK ? ": "+Eds::getErrorString(err) : ""));
+            if(stream) EdsRelease(stream);
+            return "";
+        }
+        
+        // Under its real name only once it's all there, like the download
+        std::string part = thumbnail + FINALIZE_PART_SUFFIX;
+        int fd = ::open(part.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        bool ok = fd >= 0 && ::write(fd, data, length) == (ssize_t)length;
+        if(fd >= 0 && ::close(fd) != 0) ok = false;
+        if(ok && rename(part.c_str(), thumbnail.c_str()) != 0) ok = false;
+        int error = errno;
+        EdsRelease(stream);
+        if(!ok) {
+            Logger::getInstance()->warning("can't write "+thumbnail+": "+strerror(error));
+            unlink(part.c_str());
+            return "";
+        }
+        return thumbnail;
+    }
+    
+    // ----------------------------------------------------------------------
+    // Rename (or give up on) one --mirror copy, telling the request either way
+    void Session::finalizeMirror(const request& req, TeeTarget& target, std::shared_ptr<mirrorResult> mirrored) {
+        std::string path = target.path;
+        auto failed = [this, req, path, mirrored](const std::string& error) {
+            mirrored->failed++;
+            std::string message = "mirror "+path+" failed: "+error;
+            cc::Logger::getInstance()->error(message);
+            reportError(message);
+            json j;
+            j["path"] = path;
+            j["message"] = message;
+            emit(req, "mirror-error", j);
+        };
+        
+        if(!target.error.empty()) {
+            discard(target);
+            failed(target.error);
+            return;
+        }
+        finalizer.submit(target.fd, target.part, path, [this, req, path, mirrored, failed](const std::string& error) {
+            if(!error.empty()) {
+                failed(error);
+                return;
+            }
+            mirrored->paths.push_back(path);
+            json j;
+            j["path"] = path;
+            emit(req, "mirror-finalized", j);
+        });
+    }
+    
+    // ----------------------------------------------------------------------
+    // Visit every file on every volume of the card. visit() returns true to
+    // keep the item (and release it later), false to have it released now
+    void Session::walkCard(const cardVisitor& visit) {
+        EdsUInt32 volumes = 0;
+        EDSDK_CHECK( EdsGetChildCount(camera, &volumes) )
+        for(EdsUInt32 v = 0; v < volumes; v++) {
+            EdsVolumeRef volume = NULL;
+            if(EdsGetChildAtIndex(camera, v, &volume) != EDS_ERR_OK) continue;
+            EdsVolumeInfo volumeInfo;
+            if(EdsGetVolumeInfo(volume, &volumeInfo) == EDS_ERR_OK) {
+                walkFolder(volume, volumeInfo.szVolumeLabel, visit);
+            }
+            EdsRelease(volume);
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    void Session::walkFolder(EdsBaseRef parent, const std::string& folder, const cardVisitor& visit) {
+        EdsUInt32 count = 0;
+        if(EdsGetChildCount(parent, &count) != EDS_ERR_OK) return;
+        for(EdsUInt32 i = 0; i < count; i++) {
+            EdsDirectoryItemRef item = NULL;
+            if(EdsGetChildAtIndex(parent, i, &item) != EDS_ERR_OK) continue;
+            EdsDirectoryItemInfo info;
+            if(EdsGetDirectoryItemInfo(item, &info) != EDS_ERR_OK) {
+                EdsRelease(item);
+            } else if(info.isFolder) {
+                walkFolder(item, folder+"/"+info.szFileName, visit);
+                EdsRelease(item);
+            } else if(!visit(item, info, folder)) {
+                EdsRelease(item);
+            }
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    // The folder an item is in, named the way walkCard() names it: volume label,
+    // then folders. Empty if the SDK won't say
+    std::string Session::cardFolder(EdsDirectoryItemRef item) {
+        std::string folder;
+        EdsBaseRef at = item;
+        EdsRetain(at);
+        while(true) {
+            EdsBaseRef parent = NULL;
+            EdsError err = EdsGetParent(at, &parent);
+            EdsRelease(at);
+            if(err != EDS_ERR_OK || !parent) return "";
+            at = parent;
+            
+            EdsDirectoryItemInfo info;
+            if(EdsGetDirectoryItemInfo(at, &info) == EDS_ERR_OK && info.isFolder) {
+                folder = "/" + std::string(info.szFileName) + folder;
+                continue;
+            }
+            EdsVolumeInfo volumeInfo;
+            err = EdsGetVolumeInfo(at, &volumeInfo);
+            EdsRelease(at);
+            return err == EDS_ERR_OK ? volumeInfo.szVolumeLabel + folder : "";
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    // Find what the journal says was still downloading when we last stopped,
+    // clear away its half written files, and queue it up again under the same name
+    void Session::resumeJournal() {
+        std::vector<int> slots = journal.unfinished();
+        if(slots.empty()) return;
+        
+        std::stringstream ss;
+        ss << slots.size() << " downloads didn't finish last time. looking for them on the card";
+        Logger::getInstance()->warning(ss.str());
+        
+        std::set<int> found;
+        walkCard([this, &slots, &found](EdsDirectoryItemRef item, const EdsDirectoryItemInfo& info, const std::string& folder) {
+            for(int slot : slots) {
+                const JournalEntry& e = journal.at(slot);
+                if(found.count(slot) || e.size != info.size || e.dateTime != info.dateTime || strncmp(e.name, info.szFileName, sizeof(e.name))) continue;
+                found.insert(slot);
+                
+                capture cap;
+                cap.seq = e.seq;
+                cap.epochMs = e.epochMs;
+                cap.path = e.request;
+                cap.req.id = e.id;
+                cap.journalSlot = slot;
+                cap.folder = folder;
+                if(e.durationMs > 0) {
+                    cap.stopped = high_resolution_clock::now();
+                    cap.started = cap.stopped - milliseconds(e.durationMs);
+                }
+                if(e.path[0]) {
+                    // The claim is empty, the .part partial. Neither is worth keeping
+                    std::string path(e.path, strnlen(e.path, sizeof(e.path)));
+                    unlink((path + FINALIZE_PART_SUFFIX).c_str());
+                    if(emptyFile(path)) unlink(path.c_str());
+                }
+                Logger::getInstance()->status("resuming "+folder+"/"+info.szFileName);
+                cardQueue.push_back(std::make_pair(item, cap));
+                return true;
+            }
+            return false;
+        });
+        
+        for(int slot : slots) {
+            if(found.count(slot)) continue;
+            Logger::getInstance()->warning(std::string(journal.at(slot).name)+" is no longer on the card");
+            journal.remove(slot);
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    // Estimated bytes of clips recorded but not downloaded yet, including the
+    // one being recorded now
+    uint64_t Session::pendingBytes(bool includeRecording) {
+        uint64_t bytes = 0;
+        for(const capture& cap : captures) {
+            if(cap.started == time_point()) continue;
+            bytes += disk.projected(std::chrono::duration_cast<milliseconds>(cap.stopped - cap.started).count() / 1000.0);
+        }
+        if(recording && includeRecording) {
+            bytes += disk.projected(std::chrono::duration_cast<milliseconds>(high_resolution_clock::now() - recordStarted).count() / 1000.0);
+        }
+        return bytes;
+    }
+    
+    // ----------------------------------------------------------------------
+    // With --save-to-host the camera works out shots and recording time left
+    // from what we tell it is free. Tell it what's really there, less clips
+    // that are still to come, and again whenever that moves by much
+    void Session::reportCapacity(bool force) {
+        if(!saveToHost || !sessionOpen) return;
+        
+        uint64_t usable = disk.usable();
+        uint64_t pending = pendingBytes(false);
+        uint64_t bytes = usable > pending ? usable - pending : 0;
+        if(!disk.isKnown()) bytes = (uint64_t)CAPACITY_CLUSTER_SIZE * INT32_MAX;
+        int64_t clusters = std::min<uint64_t>(bytes / CAPACITY_CLUSTER_SIZE, INT32_MAX);
+        if(!force && std::abs(clusters - reportedClusters) < CAPACITY_MIN_CHANGE / CAPACITY_CLUSTER_SIZE) return;
+        
+        EdsCapacity capacity;
+        capacity.reset = 1;
+        capacity.bytesPerSector = CAPACITY_CLUSTER_SIZE;
+        capacity.numberOfFreeClusters = (EdsInt32)clusters;
+        EdsError err = EdsSetCapacity(camera, capacity);
+        if(err != EDS_ERR_OK) {
+            Logger::getInstance()->warning("can't set capacity: "+Eds::getErrorString(err));
+            return;
+        }
+        reportedClusters = clusters;
+        
+        std::stringstream ss;
+        ss << "told the camera " << (clusters * CAPACITY_CLUSTER_SIZE) / 1000000 << " MB are free";
+        Logger::getInstance()->status(ss.str());
+    }
+    
+    // ----------------------------------------------------------------------
+    // Would a new clip fit? A clip is --max-duration long, or DISK_RECORD_RESERVE
+    // seconds without one. False to refuse; message set to warn
+    bool Session::admitRecording(std::string& message) {
+        if(disk.policy == DISK_OFF) return true;
+        disk.update();
+        if(!disk.isKnown()) return true;
+        
+        double seconds = maxDuration > 0 ? maxDuration / 1000.0 : DISK_RECORD_RESERVE;
+        uint64_t needed = disk.projected(seconds) + pendingBytes();
+        if(needed <= disk.usable()) return true;
+        
+        std::stringstream ss;
+        ss << "not enough disk space: " << seconds << " s of video needs about " << needed/1000000 << " MB, "
+           << disk.usable()/1000000 << " MB free (" << (int)disk.remaining(pendingBytes()) << " s)";
+        message = ss.str();
+        return disk.policy != DISK_REFUSE;
+    }
+    
+    // ----------------------------------------------------------------------
+    // Render a name template for a capture, and make sure its folder exists
+    const char* Session::renderPath(PathTemplate& tmpl, const char* ext, const char* name, uint64_t seq, int64_t epochMs, const char* dir) {
+        PathVars vars;
+        vars.dir = dir ? dir : defaultDir.empty() ? "." : defaultDir.c_str();
+        vars.serial = serial.c_str();
+        vars.name = name;
+        vars.ext = ext;
+        vars.index = cameraIndex;
+        vars.seq = seq;
+        vars.epochMs = epochMs;
+        
+        const char* path = tmpl.render(vars);
+        if(path && !tmpl.makeParents()) {
+            Logger::getInstance()->warning(std::string("can't create the folder for ")+path+": "+strerror(errno), LOG_SITE);
+        }
+        return path;
+    }
+    
+    // ----------------------------------------------------------------------
+    EdsError EDSCALLBACK Session::handleProgress(EdsUInt32 percent) {
+        if((int)percent >= lastProgress + 5 || (percent == 100 && lastProgress != 100)) {
+            lastProgress = percent;
+            json j;
+            j["percent"] = percent;
+            if(!current.job) emit(current.req, "download-progress", j);   // an ingest reports per file
+            
+            StatusData* status = statusPage.begin();
+            status->bytesDownloaded = status->bytesTotal * percent / 100;
+            statusPage.end();
+        }
+        return EDS_ERR_OK;
+    }
 
     
     // ----------------------------------------------------------------------
@@ -160,105 +873,759 @@ namespace cc {
         
         EDSDK_CHECK( EdsGetEvent() ) // I don't think this dos anything.
         
-        if(command_queue.size()) {
-
-            // Get the command from the queue
+        // Run everything that has been queued, so pipelined commands don't wait a loop each
+        while(true) {
+            request req;
             command_queue_mutex.lock();
-            command cmd = command_queue.back();
-            command_queue.pop_back();
+            if(command_queue.size()) {
+                req = command_queue.front();
+                command_queue.pop_front();
+                statusPage.setQueueDepth((uint32_t)command_queue.size());
+            }
             command_queue_mutex.unlock();
+            
+            if(req.cmd.empty()) break;
+            
+            // A bad command shouldn't take down a session other clients are using
+            try {
+                execute(req);
+            } catch(const std::exception& e) {
+                Logger::getInstance()->error(req.cmd[0]+": "+e.what());
+                reportError(req.cmd[0]+": "+e.what());
+                respond(req, "error", e.what());
+            }
+        }
+        
+        finalizer.update();
+        
+        // Files already on the card, one per pass like the camera's own events
+        if(!downloading && !cardQueue.empty()) {
+            std::pair<EdsDirectoryItemRef, capture> next = cardQueue.front();
+            cardQueue.pop_front();
+            current = next.second;
+            
+            // One bad file shouldn't end an ingest, or the daemon
+            try {
+                download(next.first);
+            } catch(const std::exception& e) {
+                std::string message = "can't download a file from "+(current.folder.empty() ? std::string("the card") : current.folder)+": "+e.what();
+                Logger::getInstance()->error(message);
+                reportError(message);
+                if(downloading) {   // otherwise it got as far as cleaning up
+                    json failed;
+                    failed["message"] = message;
+                    if(!current.job) failed["done"] = true;
+                    emit(current.req, "error", failed);
+                    settle(current, false, 0);
+                    EdsDownloadCancel(next.first);
+                    EdsRelease(next.first);
+                    current = capture();
+                    downloading = false;
+                    publishState();
+                }
+            }
+        }
+        
+        
+        time_point now = high_resolution_clock::now();
+        //auto elapsed = now - start;
+        //long secs = std::chrono::duration_cast<std::chrono::seconds>(elapsed).count();
+        
+        // Clips and stills on their way get the bus; live view slows down for them
+        liveView.setBusy(downloading || !captures.empty());
+        if(!downloading && liveView.update(camera)) {
+            FrameRef frame = liveView.latest();
+            if(frame) {
+                if(frameRing.isOpen()) frameRing.publish(*frame);
+                if(proxyRecorder.active()) proxyRecorder.push(frame);
+                analyze(*frame);
+            }
+        }
+        
+        // Heartbeat, so monitors can tell a hung or dead process from an idle one
+        if(disk.update()) reportCapacity();
+        double diskRemaining = disk.remaining(pendingBytes());
+        if(recording && !diskWarned && disk.policy != DISK_OFF && disk.isKnown() && diskRemaining < DISK_LOW_SECONDS) {
+            std::stringstream ss;
+            ss << "disk space for about " << (int)diskRemaining << " more seconds of recording";
+            Logger::getInstance()->warning(ss.str());
+            reportError(ss.str());
+            diskWarned = true;
+        }
+        
+        LiveViewStats lv = liveView.stats();
+        StatusData* status = statusPage.begin();
+        status->liveviewFps = (float)lv.fps;
+        status->liveviewRate = lv.active ? (float)lv.rate : 0;
+        status->liveviewLatency = (float)lv.latencyAvg;
+        status->diskFree = disk.available();
+        status->diskRemaining = (float)diskRemaining;
+        statusPage.end();
+        
+        if( now > next_keepalive) {
+            Logger::getInstance()->status("sending keep alive");
+            EdsSendStatusCommand(camera, kEdsCameraCommand_ExtendShutDownTimer, 0);
+            next_keepalive = now + std::chrono::seconds(60);
+        }
+    }
 
+    
+    // ----------------------------------------------------------------------
+    // Per-frame analysis of live view, on the session thread right after the pull
+    void Session::analyze(const Frame& frame) {
+        if(!recording) motionRecording = false;
+        
+        int change = motion.update(frame);
+        if(change != MOTION_NONE && watched("motion")) {
+            json j;
+            j["moving"] = motion.moving;
+            j["score"] = motion.score;
+            j["frame"] = frame.sequence;
+            broadcast("motion", j);
+        }
+        switch(change) {
+            case MOTION_START:
+                Logger::getInstance()->status("motion detected");
+                if(!recording) {
+                    addCommand({"@motion", "record"});
+                    motionRecording = true;
+                }
+                break;
+            case MOTION_STOP:
+                Logger::getInstance()->status("motion stopped");
+                if(motionRecording) {
+                    addCommand({"@motion", "stop"});
+                    motionRecording = false;
+                }
+                break;
+        }
+        
+        if(exposure.enabled && frame.width) {
+            const ExposureStats& stats = exposure.update(frame);
+            StatusData* status = statusPage.begin();
+            status->exposureMean = (float)stats.mean;
+            status->shadows = (float)stats.shadows;
+            status->highlights = (float)stats.highlights;
+            statusPage.end();
+            if(watched("exposure")) broadcast("exposure", ExposureMeter::toJSON(stats, EXPOSURE_EVENT_BINS));
+        }
+        
+        if(focus.enabled && frame.width) {
+            focus.update(frame);
+            StatusData* status = statusPage.begin();
+            status->focus = (float)focus.score;
+            statusPage.end();
+            if(watched("focus")) {
+                json j;
+                j["score"] = focus.score;
+                j["peak"] = focus.peak;
+                j["frame"] = focus.frame;
+                j["processMs"] = focus.processMs;
+                broadcast("focus", j);
+            }
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    bool Session::watched(const std::string& topic) {
+        for(auto& w : watchers) {
+            if(w.first.compare(topic)==0) return true;
+        }
+        return false;
+    }
+    
+    // ----------------------------------------------------------------------
+    // Send an event to everybody watching a topic. Watchers whose client has
+    // disconnected are dropped here rather than tracked by the servers.
+    void Session::broadcast(const std::string& topic, const json& body) {
+        for(auto it = watchers.begin(); it != watchers.end(); ) {
+            if(it->second.connected && !*it->second.connected) {
+                it = watchers.erase(it);
+                continue;
+            }
+            if(it->first.compare(topic)==0) emit(it->second, topic, body);
+            ++it;
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    void Session::execute(request& req) {
+        command& cmd = req.cmd;
+        
+        StatusData* status = statusPage.begin();
+        status->commands++;
+        statusPage.end();
+        
+        if(cmd[0].compare("record")==0) {
+            std::string diskWarning;
+            if(isRecording()) {
+                Logger::getInstance()->warning("already recording");
+                respond(req, "error", "already recording");
+            } else if(!admitRecording(diskWarning)) {
+                Logger::getInstance()->warning(diskWarning);
+                respond(req, "error", diskWarning);
+            } else {
+                Logger::getInstance()->status("start recording");
+                EdsUInt32 record_start = 4; // Begin movie shooting
+                EDSDK_CHECK( EdsSetPropertyData(camera, kEdsPropID_Record, 0, sizeof(record_start), &record_start) )
+                recordStarted = high_resolution_clock::now();
+                recordSeq = sequence.next();
+                recordEpochMs = StatusPage::now();
+                recording = true;
+                diskWarned = false;
+                publishState();
+                respond(req, "ok", "recording", false);
+                
+                json j;
+                if(disk.isKnown()) j["remaining"] = (int64_t)disk.remaining(pendingBytes());
+                if(!diskWarning.empty()) {
+                    Logger::getInstance()->warning(diskWarning);
+                    j["warning"] = diskWarning;
+                }
+                if(recordProxy) {
+                    // Named like the clip will be, so they sort together
+                    const char* proxyPath = renderPath(pathTemplate, "proxy.avi", "", recordSeq, recordEpochMs);
+                    if(proxyPath && proxyRecorder.begin(proxyPath, liveView.stats().targetFps, steady_clock::now())) {
+                        liveView.retain();
+                        j["proxy"] = proxyPath;
+                    }
+                }
+                j["done"] = true;
+                emit(req, "recording-started", j);
+            }
+        }
+        
+        
+        else if(cmd[0].compare("stop")==0) {
+            if(!isRecording()) {
+                Logger::getInstance()->warning("not recording");
+                respond(req, "error", "not recording");
+            } else {
+                capture cap;
+                cap.req = req;
+                cap.started = recordStarted;
+                cap.seq = recordSeq;
+                cap.epochMs = recordEpochMs;
+                if(cmd.size() > 1) {
+                    cap.path = requestedPath(cmd[1]);
+                }
+                
+                Logger::getInstance()->status("stopping");
+                EdsUInt32 record_stop = 0; // End movie shooting
+                EDSDK_CHECK( EdsSetPropertyData(camera, kEdsPropID_Record, 0, sizeof(record_stop), &record_stop) )
+                cap.stopped = high_resolution_clock::now();
+                captures.push_back(cap);
+                recording = false;
+                publishState();
+                respond(req, "ok", "stopping", false); // done when the file is finalized
+                json j;
+                j["duration"] = std::chrono::duration_cast<milliseconds>(cap.stopped - cap.started).count() / 1000.0;
+                emit(req, "recording-stopped", j);
+                
+                if(proxyRecorder.active()) {
+                    ProxyResult proxy = proxyRecorder.end();
+                    liveView.release();
+                    json p;
+                    p["path"] = proxy.path;
+                    p["frames"] = proxy.frames;
+                    p["repeated"] = proxy.repeated;
+                    p["dropped"] = proxy.dropped;
+                    p["size"] = proxy.bytes;
+                    p["duration"] = proxy.duration;
+                    if(proxy.ok) {
+                        emit(req, "proxy-finalized", p);
+                    } else {
+                        p["message"] = "couldn't write the proxy";
+                        emit(req, "proxy-error", p);
+                    }
+                }
+            }
+        }
+        
+        else if(cmd[0].compare("picture")==0) {
+            // print_status("not yet implemented");
+            if(isRecording()) {
+                Logger::getInstance()->warning("can't take a picture while recording");
+                respond(req, "error", "can't take a picture while recording");
+            } else {
+                capture cap;
+                cap.req = req;
+                if(cmd.size() > 1) {
+                    cap.path = requestedPath(cmd[1]);
+                }
+                cap.seq = sequence.next();
+                cap.epochMs = StatusPage::now();
+                EDSDK_CHECK( EdsSendCommand(camera, kEdsCameraCommand_TakePicture, 0) )
+                captures.push_back(cap);
+                respond(req, "ok", "picture taken", false);
+            }
+        }
+        
+        else if(cmd[0].compare("cancel")==0) {
+            if(!isRecording()) {
+                Logger::getInstance()->warning("not recording");
+                respond(req, "error", "not recording");
+            } else {
+                Logger::getInstance()->status("canceling");
+                capture cap;
+                cap.req = req;
+                cap.canceled = true;
+                EdsUInt32 record_stop = 0; // End movie shooting
+                EDSDK_CHECK( EdsSetPropertyData(camera, kEdsPropID_Record, 0, sizeof(record_stop), &record_stop) )
+                captures.push_back(cap);
+                recording = false;
+                publishState();
+                respond(req, "ok", "canceling", false);
+
+                // No clip to go with it, so the proxy goes too
+                if(proxyRecorder.active()) {
+                    ProxyResult proxy = proxyRecorder.end();
+                    liveView.release();
+                    unlink(proxy.path.c_str());
+                    json p;
+                    p["path"] = proxy.path;
+                    emit(req, "proxy-discarded", p);
+                }
+            }
+        }
+        
+        else if(cmd[0].compare("state")==0) {
+            if(isRecording()) {
+                Logger::getInstance()->status("state recording");
+                respond(req, "ok", "recording");
+            } else if(sessionOpen) {
+                Logger::getInstance()->status("state open");
+                respond(req, "ok", "open");
+            } else {
+                Logger::getInstance()->status("state closed");
+                respond(req, "ok", "closed");
+            }
+
+        }
+        
+        else if(cmd[0].compare("disk")==0) {
+            disk.update(true);
+            uint64_t pending = pendingBytes();
+            json j;
+            j["path"] = defaultDir.empty() ? "." : defaultDir;
+            j["policy"] = DiskSpace::policyName(disk.policy);
+            j["known"] = disk.isKnown();
+            j["free"] = disk.available();
+            j["total"] = disk.total();
+            j["bitrate"] = disk.bitrate() * 8;
+            j["bitrateClips"] = disk.basedOn();
+            j["pending"] = pending;
+            j["remaining"] = disk.remaining(pending);
+            j["status"] = "ok";
+            j["done"] = true;
+            emit(req, "result", j);
+        }
+        
+        else if(cmd[0].compare("liveview")==0) {
+            // liveview [on|off|fps <n>]
+            if(cmd.size() > 1 && cmd[1].compare("on")==0) {
+                if(!liveViewRequested) liveView.retain();
+                liveViewRequested = true;
+            } else if(cmd.size() > 1 && cmd[1].compare("off")==0) {
+                if(liveViewRequested) liveView.release();
+                liveViewRequested = false;
+            } else if(cmd.size() > 2 && cmd[1].compare("fps")==0) {
+                liveView.setFps(atof(cmd[2].c_str()));
+            }
             
-            if(cmd[0].compare("record")==0) {
-                if(isRecording()) {
-                    Logger::getInstance()->warning("already recording");
-                } else {
-                    Logger::getInstance()->status("start recording");
-                    EdsUInt32 record_start = 4; // Begin movie shooting
-                    EDSDK_CHECK( EdsSetPropertyData(camera, kEdsPropID_Record, 0, sizeof(record_start), &record_start) )
+            LiveViewStats stats = liveView.stats();
+            json j;
+            j["active"] = stats.active;
+            j["busy"] = stats.busy;
+            j["fps"] = stats.fps;
+            j["targetFps"] = stats.targetFps;
+            j["rate"] = stats.rate;
+            j["consumers"] = stats.consumers;
+            j["followers"] = stats.followers;
+            j["skipped"] = stats.skipped;
+            j["frames"] = stats.frames;
+            j["dropped"] = stats.dropped;
+            j["notReady"] = stats.notReady;
+            j["errors"] = stats.errors;
+            j["latency"] = stats.latency;
+            j["latencyAvg"] = stats.latencyAvg;
+            j["frameSize"] = stats.lastSize;
+            j["status"] = "ok";
+            j["done"] = true;
+            emit(req, "result", j);
+        }
+        
+        else if(cmd[0].compare("motion")==0) {
+            // motion [on|off|threshold <n>|hold <seconds>|roi <x,y,w,h>]
+            if(cmd.size() > 1 && cmd[1].compare("on")==0) {
+                if(!motion.enabled) {
+                    motion.enabled = true;
+                    motion.reset();
+                    liveView.retainDecoded();
+                }
+            } else if(cmd.size() > 1 && cmd[1].compare("off")==0) {
+                if(motion.enabled) {
+                    motion.enabled = false;
+                    motion.moving = false;
+                    liveView.releaseDecoded();
+                }
+            } else if(cmd.size() > 2 && cmd[1].compare("threshold")==0) {
+                motion.threshold = atof(cmd[2].c_str());
+            } else if(cmd.size() > 2 && cmd[1].compare("hold")==0) {
+                motion.hold = atof(cmd[2].c_str());
+            } else if(cmd.size() > 2 && cmd[1].compare("roi")==0) {
+                if(!motion.setROI(cmd[2])) {
+                    respond(req, "error", "roi is x,y,w,h as fractions of the frame");
+                    return;
                 }
             }
             
+            json j;
+            j["enabled"] = motion.enabled;
+            j["moving"] = motion.moving;
+            j["score"] = motion.score;
+            j["threshold"] = motion.threshold;
+            j["hold"] = motion.hold;
+            j["roi"] = motion.getROI();
+            j["frames"] = motion.frames;
+            j["processMs"] = motion.processMs;
+            j["isa"] = simd::isa();
+            j["status"] = "ok";
+            j["done"] = true;
+            emit(req, "result", j);
+        }
+        
+        else if(cmd[0].compare("exposure")==0) {
+            // exposure [on|off]
+            if(cmd.size() > 1 && cmd[1].compare("on")==0) {
+                if(!exposure.enabled) {
+                    exposure.enabled = true;
+                    liveView.retainDecoded();
+                }
+            } else if(cmd.size() > 1 && cmd[1].compare("off")==0) {
+                if(exposure.enabled) {
+                    exposure.enabled = false;
+                    liveView.releaseDecoded();
+                }
+            }
             
-            else if(cmd[0].compare("stop")==0) {
-                if(!isRecording()) {
-                    Logger::getInstance()->warning("not recording");
-                } else {
-                    
-                    if(cmd.size() > 1) {
-                       
-                        if(defaultDir.empty() || cmd[1].at(0)=='/') {
-                            outfile = cmd[1];
-                        } else {
-                            std::stringstream ss;
-                            ss << defaultDir << "/" << cmd[1];
-                            outfile = ss.str();
-                        }
-                       
-                        if(!overwrite && fileExists(outfile)) {
-                            Logger::getInstance()->warning(outfile + " already exists. using defualt name instead");
-                            outfile = "";
-                        }
-                    }
-                    
-                    Logger::getInstance()->status("stopping");
-                    EdsUInt32 record_stop = 0; // End movie shooting
-                    EDSDK_CHECK( EdsSetPropertyData(camera, kEdsPropID_Record, 0, sizeof(record_stop), &record_stop) )
+            json j = ExposureMeter::toJSON(exposure.stats(), 256);
+            j["enabled"] = exposure.enabled;
+            j["status"] = "ok";
+            j["done"] = true;
+            emit(req, "result", j);
+        }
+        
+        else if(cmd[0].compare("focus")==0) {
+            // focus [on|off|reset|roi <x,y,w,h>]
+            if(cmd.size() > 1 && cmd[1].compare("on")==0) {
+                if(!focus.enabled) {
+                    focus.enabled = true;
+                    focus.reset();
+                    liveView.retainDecoded();
                 }
+            } else if(cmd.size() > 1 && cmd[1].compare("off")==0) {
+                if(focus.enabled) {
+                    focus.enabled = false;
+                    liveView.releaseDecoded();
+                }
+            } else if(cmd.size() > 1 && cmd[1].compare("reset")==0) {
+                focus.reset();
+            } else if(cmd.size() > 2 && cmd[1].compare("roi")==0) {
+                if(!focus.roi.parse(cmd[2])) {
+                    respond(req, "error", "roi is x,y,w,h as fractions of the frame");
+                    return;
+                }
+                focus.reset();
             }
             
-            else if(cmd[0].compare("picture")==0) {
-                // print_status("not yet implemented");
-                if(isRecording()) {
-                    Logger::getInstance()->warning("can't take a picture while recording");
+            json j;
+            j["enabled"] = focus.enabled;
+            j["score"] = focus.score;
+            j["peak"] = focus.peak;
+            j["frame"] = focus.frame;
+            j["roi"] = focus.roi.toString();
+            j["processMs"] = focus.processMs;
+            j["status"] = "ok";
+            j["done"] = true;
+            emit(req, "result", j);
+        }
+        
+        else if(cmd[0].compare("watch")==0) {
+            // watch <motion|exposure|focus>... : events for the topics until "unwatch"
+            static const std::set<std::string> topics = {"motion", "exposure", "focus"};
+            if(cmd.size() < 2) {
+                respond(req, "error", "watch what? motion, exposure, focus");
+                return;
+            }
+            for(size_t i=1; i<cmd.size(); ++i) {
+                if(!topics.count(cmd[i])) {
+                    respond(req, "error", "can't watch "+cmd[i]);
+                    return;
+                }
+            }
+            for(size_t i=1; i<cmd.size(); ++i) {
+                watchers.push_back(std::make_pair(cmd[i], req));
+            }
+            respond(req, "ok", "watching", false);
+        }
+        
+        else if(cmd[0].compare("unwatch")==0) {
+            // unwatch [topic...] : ends this client's watches, all of them by default
+            std::set<std::string> topics(cmd.begin()+1, cmd.end());
+            for(auto it = watchers.begin(); it != watchers.end(); ) {
+                if(it->second.connected == req.connected && (topics.empty() || topics.count(it->first))) {
+                    json j;
+                    j["topic"] = it->first;
+                    j["done"] = true;
+                    emit(it->second, "unwatched", j);
+                    it = watchers.erase(it);
                 } else {
-                    outfile = "";
-                    if(cmd.size() > 1) {
-                        outfile = cmd[1];
+                    ++it;
+                }
+            }
+            respond(req, "ok", "");
+        }
+        
+        else if(cmd[0].compare("devices")==0) {
+            json j;
+            j["devices"] = json::parse(getDevicesAsJSON());
+            j["status"] = "ok";
+            j["done"] = true;
+            emit(req, "result", j);
+        }
+        
+        else if(cmd[0].compare("ingest")==0 || cmd[0].compare("sync")==0) {
+            // ingest [folder] : download what's on the card, or just under a folder like CARD/DCIM/100CANON
+            // sync [folder] : the same, but only what hasn't been downloaded before or has changed since
+            // ingest|sync status|cancel
+            bool sync = cmd[0].compare("sync")==0;
+            bool running = ingesting && ingesting->finished + ingesting->failed < ingesting->files;
+            if(cmd.size() > 1 && cmd[1].compare("status")==0) {
+                if(!ingesting) {
+                    respond(req, "error", "nothing ingested yet");
+                    return;
+                }
+                json j = ingestStats(*ingesting);
+                j["running"] = running;
+                j["status"] = "ok";
+                j["done"] = true;
+                emit(req, "result", j);
+                return;
+            }
+            if(cmd.size() > 1 && cmd[1].compare("cancel")==0) {
+                if(!running) {
+                    respond(req, "error", "not ingesting");
+                    return;
+                }
+                // Files already downloaded or on their way to the disk are kept
+                ingesting->canceled = true;
+                for(auto it = cardQueue.begin(); it != cardQueue.end(); ) {
+                    if(it->second.job != ingesting) {
+                        ++it;
+                        continue;
                     }
-                    EDSDK_CHECK( EdsSendCommand(camera, kEdsCameraCommand_TakePicture, 0) )
+                    EdsDirectoryItemInfo info;
+                    if(EdsGetDirectoryItemInfo(it->first, &info) == EDS_ERR_OK) ingesting->bytes -= info.size;
+                    ingesting->files--;
+                    EdsRelease(it->first);
+                    it = cardQueue.erase(it);
                 }
+                respond(req, "ok", "canceled");
+                if(ingesting->finished + ingesting->failed >= ingesting->files) reportIngest(*ingesting);
+                return;
+            }
+            if(running) {
+                respond(req, "error", "already ingesting");
+                return;
             }
+            std::string under = cmd.size() > 1 ? cmd[1] : "";
             
-            else if(cmd[0].compare("cancel")==0) {
-                if(!isRecording()) {
-                    Logger::getInstance()->warning("not recording");
-                } else {
-                    Logger::getInstance()->status("canceling");
-                    canceled = true;
-                    EdsUInt32 record_stop = 0; // End movie shooting
-                    EDSDK_CHECK( EdsSetPropertyData(camera, kEdsPropID_Record, 0, sizeof(record_stop), &record_stop) )
-                }
+            // Downloads the journal is already resuming stay with it
+            std::set<std::string> journaled;
+            for(int slot : journal.unfinished()) {
+                const JournalEntry& e = journal.at(slot);
+                std::stringstream key;
+                key << std::string(e.name, strnlen(e.name, sizeof(e.name))) << "/" << e.size << "/" << e.dateTime;
+                journaled.insert(key.str());
             }
             
-            else if(cmd[0].compare("state")==0) {
-                if(isRecording()) {
-                    Logger::getInstance()->status("state recording");
-                } else if(sessionOpen) {
-                    Logger::getInstance()->status("state open");
-                } else {
-                    Logger::getInstance()->status("state closed");
+            std::shared_ptr<ingestJob> job = std::make_shared<ingestJob>();
+            job->req = req;
+            job->started = high_resolution_clock::now();
+            size_t unchanged = 0, changed = 0;
+            walkCard([&](EdsDirectoryItemRef item, const EdsDirectoryItemInfo& info, const std::string& folder) {
+                if(folder.compare(0, under.size(), under) != 0) return false;
+                std::stringstream key;
+                key << info.szFileName << "/" << info.size << "/" << info.dateTime;
+                if(journaled.count(key.str())) return false;
+                if(sync && synced.contains(folder, info.szFileName, info.size, info.dateTime)) {
+                    unchanged++;
+                    return false;
                 }
-
+                if(sync && synced.seen(folder, info.szFileName)) changed++;
+                
+                // Named for when it was shot, not when it came off the card
+                capture cap;
+                cap.req = job->req;
+                cap.epochMs = (int64_t)info.dateTime * 1000;
+                cap.job = job;
+                cap.folder = folder;
+                cardQueue.push_back(std::make_pair(item, cap));
+                job->files++;
+                job->bytes += info.size;
+                return true;
+            });
+            ingesting = job;
+            
+            double walkSeconds = std::chrono::duration<double>(high_resolution_clock::now() - job->started).count();
+            
+            std::stringstream ss;
+            ss << "ingesting " << job->files << " files, " << job->bytes/1000000 << " MB";
+            if(sync) ss << " (" << changed << " changed, " << unchanged << " already downloaded)";
+            Logger::getInstance()->status(ss.str());
+            respond(req, "ok", ss.str(), false);
+            json j;
+            j["files"] = job->files;
+            j["bytes"] = job->bytes;
+            if(sync) {
+                j["changed"] = changed;
+                j["unchanged"] = unchanged;
+            }
+            j["walkSeconds"] = walkSeconds;
+            emit(req, "ingest-started", j);
+            if(job->files == 0) reportIngest(*job);
+        }
+        
+        else if(cmd[0].compare("captures")==0) {
+            // captures [since <time>] [until <time>] [camera <serial>] [limit <n>]
+            CatalogQuery q;
+            q.limit = MAX_RECENT_CAPTURES;
+            for(size_t i = 1; i+1 < cmd.size(); i += 2) {
+                if(cmd[i]=="since" && parseTime(cmd[i+1], q.since)) continue;
+                if(cmd[i]=="until" && parseTime(cmd[i+1], q.until)) continue;
+                if(cmd[i]=="camera") { q.serial = cmd[i+1]; continue; }
+                if(cmd[i]=="limit" && cmd[i+1]=="all") { q.limit = 0; continue; }
+                if(cmd[i]=="limit" && isdigit((unsigned char)cmd[i+1][0])) {
+                    char* end = NULL;
+                    errno = 0;
+                    unsigned long long n = strtoull(cmd[i+1].c_str(), &end, 10);
+                    if(!*end && errno != ERANGE) {
+                        q.limit = n;
+                        continue;
+                    }
+                }
+                throw std::runtime_error("usage: captures [since <time>] [until <time>] [camera <serial>] [limit <n|all>]");
+            }
+            if(cmd.size() % 2 == 0) {
+                throw std::runtime_error("usage: captures [since <time>] [until <time>] [camera <serial>] [limit <n|all>]");
             }
             
-            else {
-                Logger::getInstance()->warning("unknown command: "+cmd[0]);
+            json list = json::array();
+            for(const CatalogRecord& r : catalog.query(q)) {
+                json c;
+                if(r.id[0]) c["id"] = std::string(r.id, strnlen(r.id, sizeof(r.id)));
+                c["path"] = std::string(r.path, strnlen(r.path, sizeof(r.path)));
+                c["serial"] = std::string(r.serial, strnlen(r.serial, sizeof(r.serial)));
+                c["format"] = r.format == EDSDK_MOV_FORMAT ? "mov" : r.format == EDSDK_JPG_FORMAT ? "jpg" : "other";
+                c["size"] = r.size;
+                c["hash"] = XXHash64::hex(r.hash);
+                c["started"] = r.started;
+                c["stopped"] = r.stopped;
+                c["duration"] = (r.stopped - r.started) / 1000.0;
+                c["time"] = r.finalized / 1000;
+                list.push_back(c);
             }
+            json j;
+            j["captures"] = list;
+            j["total"] = catalog.size();
+            j["status"] = "ok";
+            j["done"] = true;
+            emit(req, "result", j);
         }
         
+        else {
+            Logger::getInstance()->warning("unknown command: "+cmd[0], LOG_SITE);
+            respond(req, "error", "unknown command: "+cmd[0]);
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void Session::respond(const request& req, const std::string& status, const std::string& message, bool done) {
+        json j;
+        j["status"] = status;
+        if(!message.empty()) j["message"] = message;
+        if(done || status.compare("ok")!=0) j["done"] = true;
+        emit(req, "result", j);
+    }
+    
+    // ----------------------------------------------------------------------
+    void Session::reportError(const std::string& message) {
+        StatusData* status = statusPage.begin();
+        status->errors++;
+        StatusPage::copy(status->lastError, message, sizeof(status->lastError));
+        statusPage.end();
+    }
+    
+    // ----------------------------------------------------------------------
+    void Session::publishState() {
+        StatusData* status = statusPage.begin();
+        if(!sessionOpen) status->state = STATUS_CLOSED;
+        else if(downloading) status->state = STATUS_DOWNLOADING;
+        else if(recording) status->state = STATUS_RECORDING;
+        else status->state = STATUS_OPEN;
+        status->recordStarted = recording ? StatusPage::now() - std::chrono::duration_cast<milliseconds>(high_resolution_clock::now() - recordStarted).count() : 0;
+        if(!downloading) status->currentFile[0] = 0;
+        statusPage.end();
+    }
+    
+    // ----------------------------------------------------------------------
+    void Session::addCommand(command cmd, responder respond, connection connected) {
+        request req;
+        if(cmd.size() && cmd[0].size() > 1 && cmd[0].at(0)=='@') {
+            req.id = cmd[0].substr(1);
+            cmd.erase(cmd.begin());
+        }
+        if(cmd.empty()) return;
         
-        time_point now = high_resolution_clock::now();
-        //auto elapsed = now - start;
-        //long secs = std::chrono::duration_cast<std::chrono::seconds>(elapsed).count();
+        req.cmd = cmd;
+        req.respond = respond;
+        req.connected = connected;
+        emit(req, "ack");
         
-        if( now > next_keepalive) {
-            Logger::getInstance()->status("sending keep alive");
-            EdsSendStatusCommand(camera, kEdsCameraCommand_ExtendShutDownTimer, 0);
-            next_keepalive = now + std::chrono::seconds(60);
-        }
+        command_queue_mutex.lock();
+        command_queue.push_back(req);
+        statusPage.setQueueDepth((uint32_t)command_queue.size());
+        command_queue_mutex.unlock();
+        command_queue_cv.notify_one();
+    }
+    
+    // ----------------------------------------------------------------------
+    milliseconds Session::idleTime() {
+        if(!cardQueue.empty()) return milliseconds(0);
+        milliseconds idle = std::chrono::duration_cast<milliseconds>(liveView.untilDue());
+        if(finalizer.waiting()) idle = std::min(idle, finalizer.untilDue());
+        return std::min(idle, milliseconds(100));
+    }
+    
+    // ----------------------------------------------------------------------
+    void Session::waitForCommands(milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(command_queue_mutex);
+        command_queue_cv.wait_for(lock, timeout, [this]{ return !command_queue.empty(); });
     }
 
+    // ----------------------------------------------------------------------
+    command Session::parseCommand(std::string input) {
+        // Clear out any quotes. It fucks shit up.
+        input.erase( std::remove( input.begin(), input.end(), '\"' ), input.end() );
+        
+        // Split the input string into words
+        command cmd;
+        std::istringstream iss(input);
+        for(std::string s; iss >> s;) cmd.push_back(s);
+        return cmd;
+    }
+    
     
     // ----------------------------------------------------------------------
     void Session::updateCameraList() {
@@ -306,7 +1673,25 @@ namespace cc {
         cc::Logger::getInstance()->status("opening session");
         EDSDK_CHECK( EdsOpenSession(camera) )
         sessionOpen = true;
-        cc::Logger::getInstance()->status("opened session with "+getSerial());
+        serial = getSerial();
+        cc::Logger::getInstance()->status("opened session with "+serial);
+        sequence.open(SequenceCounter::defaultPath(defaultDir, serial));
+        catalog.open(Catalog::defaultPath(defaultDir));
+        
+        // Guess clip sizes from this camera's last few clips until it makes new ones
+        disk.setPath(defaultDir);
+        CatalogQuery recent;
+        recent.serial = serial;
+        recent.limit = 10;
+        for(const CatalogRecord& r : catalog.query(recent)) {
+            if(r.format == EDSDK_MOV_FORMAT) disk.learn(r.size, (r.stopped - r.started) / 1000.0);
+        }
+        
+        statusPage.open(cameraIndex);
+        StatusData* status = statusPage.begin();
+        StatusPage::copy(status->serial, serial, sizeof(status->serial));
+        statusPage.end();
+        publishState();
         
     
 
@@ -315,6 +1700,28 @@ namespace cc {
         EdsGetPropertyData(camera, kEdsPropID_Evf_OutputDevice, 0, sizeof(device), &device);
         device |= kEdsEvfOutputDevice_PC;
         EdsSetPropertyData(camera, kEdsPropID_Evf_OutputDevice, 0, sizeof(device), &device);
+        
+        // Since it's on anyway, have the frame ring ready for whoever wants it
+        liveView.setup();
+        
+        if(shareFrames) {
+            frameRing.open(cameraIndex, shareFramesWidth > 0);
+            if(shareFramesWidth > 0) {
+                liveView.setDecodeWidth(shareFramesWidth);
+                liveView.retainDecoded();
+            } else {
+                liveView.retain();
+            }
+        }
+        if(motion.enabled) {
+            liveView.retainDecoded();
+        }
+        if(exposure.enabled) {
+            liveView.retainDecoded();
+        }
+        if(focus.enabled) {
+            liveView.retainDecoded();
+        }
 
         
     
@@ -324,16 +1731,17 @@ namespace cc {
             EdsUInt32 saveTo = kEdsSaveTo_Host;
             EDSDK_CHECK( EdsSetPropertyData(camera, kEdsPropID_SaveTo, 0, sizeof(saveTo) , &saveTo) )
             
-            EdsCapacity capacity;// = {0x7FFFFFFF, 0x1000, 1};
-            capacity.reset = 1;
-            capacity.bytesPerSector = 512*8;
-            capacity.numberOfFreeClusters = 36864*9999;
-            EDSDK_CHECK( EdsSetCapacity(camera, capacity) )
+            reportCapacity(true);
         } else {
             cc::Logger::getInstance()->status("kEdsSaveTo_Camera");
             EdsUInt32 saveTo = kEdsSaveTo_Camera;
             EDSDK_CHECK( EdsSetPropertyData(camera, kEdsPropID_SaveTo, 0, sizeof(saveTo), &saveTo) )
         }
+        
+        journal.sync = finalizer.policy != SYNC_NONE;
+        journal.open(Journal::defaultPath(defaultDir, serial));
+        resumeJournal();
+        synced.open(SyncIndex::defaultPath(defaultDir, serial));
     }
 
 
@@ -356,15 +1764,28 @@ namespace cc {
     
     // ----------------------------------------------------------------------
     EdsError EDSCALLBACK Session::handleEvent(EdsObjectEvent event, EdsBaseRef object) {
-        Logger::getInstance()->status(Eds::getObjectEventString(event));
+        Logger::getInstance()->status(Eds::getObjectEventString(event), LOG_SITE);
 
         if(!object)
             return EDS_ERR_OK;
         if(event == kEdsObjectEvent_DirItemCreated) {
-            if(canceled) {
+            // Files show up in the order they were asked for. Anything else was
+            // shot from the camera body and gets a default name.
+            current = capture();
+            if(captures.size()) {
+                current = captures.front();
+                captures.pop_front();
+            }
+            
+            if(current.canceled) {
                 EDSDK_CHECK( EdsDeleteDirectoryItem(object) )
-                canceled = false;
+                json j;
+                j["done"] = true;
+                emit(current.req, "canceled", j);
+                current = capture();
             } else {
+                // So "sync" knows it has this one, whether or not it stays on the card
+                current.folder = cardFolder(object);
                 return download(object);
             }
         } else if(event == kEdsObjectEvent_DirItemRemoved) {
@@ -381,7 +1802,7 @@ namespace cc {
     EdsError EDSCALLBACK Session::handleProperty(EdsPropertyEvent event, EdsPropertyID propertyId, EdsUInt32 param){
         std::stringstream ss;
         ss << Eds::getPropertyEventString(event) << ": " << Eds::getPropertyIDString(propertyId) << " / " << param;
-        Logger::getInstance()->verbose(ss.str());
+        Logger::getInstance()->verbose(ss.str(), LOG_SITE);
         
         return EDS_ERR_OK;
     }
@@ -392,7 +1813,7 @@ namespace cc {
     
         std::stringstream ss;
         ss << Eds::getPropertyEventString(event) << ": " << param;
-        Logger::getInstance()->status(ss.str());
+        Logger::getInstance()->status(ss.str(), LOG_SITE);
         
         if(event == kEdsStateEvent_ShutDownTimerUpdate) {
             cc::Logger::getInstance()->status("shutdown timer extended.");
@@ -406,10 +1827,13 @@ namespace cc {
             EDSDK_CHECK( EdsCloseSession(camera) )
             sessionOpen = false;
             downloading = false;
+            publishState();
+            statusPage.close();
+            frameRing.close();
             exit(0);
         }
         else {
-            cc::Logger::getInstance()->warning("unknown state");
+            cc::Logger::getInstance()->warning("unknown state", LOG_SITE);
         }
         
         return EDS_ERR_OK;
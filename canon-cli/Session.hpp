@@ -12,11 +12,38 @@
 #define EDSDK_CHECK(X) if(X!=EDS_ERR_OK) { throw std::runtime_error(Eds::getErrorString(X)); }
 #define EDSDK_MOV_FORMAT 45317
 #define EDSDK_JPG_FORMAT 14337
+#define MAX_RECENT_CAPTURES 50        // what "captures" lists without a limit
+#define DOWNLOAD_CHUNK_SIZE (1024*1024)
+#define DOWNLOAD_NAME_ATTEMPTS 100     // fresh {seq} numbers to try when a default name is taken
+#define CAPACITY_CLUSTER_SIZE 4096
+#define CAPACITY_MIN_CHANGE (64*1024*1024)  // bytes of change before the camera hears about it again
+#define THUMBNAIL_SUFFIX ".thumb.jpg"
 
 #include <sys/stat.h>
 #include <vector>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <condition_variable>
 #include <exception>
 #include "Logger.hpp"
+#include "StatusPage.hpp"
+#include "LiveView.hpp"
+#include "FrameRing.hpp"
+#include "MotionDetector.hpp"
+#include "ExposureMeter.hpp"
+#include "FocusMeter.hpp"
+#include "json.hpp"
+#include "ProxyRecorder.hpp"
+#include "PathTemplate.hpp"
+#include "SequenceCounter.hpp"
+#include "Finalizer.hpp"
+#include "Catalog.hpp"
+#include "DiskSpace.hpp"
+#include "Tee.hpp"
+#include "Journal.hpp"
+#include "SyncIndex.hpp"
 
 #include "EDSDK.h"
 #include "EDSDKErrors.h"
@@ -29,11 +56,65 @@ namespace cc {
     
     typedef std::vector<std::string> command;
     
+    // Called with one-line JSON events for a command: an "ack" when it is queued,
+    // a "result" once it has run, and any completion events after that. The last
+    // event for a request has "done":true.
+    typedef std::function<void(const std::string&)> responder;
+    
     typedef std::chrono::high_resolution_clock::time_point time_point;
     typedef std::chrono::high_resolution_clock high_resolution_clock;
     typedef std::chrono::milliseconds milliseconds;
+    
+    // Cleared by the server when the client that sent a request goes away. Null
+    // for stdin, which is always there.
+    typedef std::shared_ptr<std::atomic<bool>> connection;
+    
+    struct request {
+        std::string id;     // client supplied, from a leading "@<id>" word
+        command cmd;
+        responder respond;
+        connection connected;
+    };
+    
+    // An "ingest" of files already on the card, and how far it has got
+    struct ingestJob {
+        request req;
+        size_t files = 0;           // queued
+        size_t finished = 0;
+        size_t failed = 0;
+        uint64_t bytes = 0;         // of the queued files
+        uint64_t done = 0;          // of the finished ones
+        double transferSeconds = 0; // in EdsDownload, for the bus rate
+        time_point started;
+        time_point ended;
+        bool canceled = false;
+    };
+    
+    // A file we expect the camera to create, waiting for its kEdsObjectEvent_DirItemCreated
+    struct capture {
+        request req;
+        std::string path;       // requested output name, as a template. empty for the default
+        uint64_t seq = 0;       // fixed when the capture is asked for. 0: assign at download
+        int64_t epochMs = 0;
+        bool canceled = false;
+        time_point started;     // recording start, for videos
+        time_point stopped;
+        int journalSlot = -1;   // once the download has started
+        std::shared_ptr<ingestJob> job;     // for files pulled off the card by "ingest"
+        std::string folder;     // where on the card, when it was found by walking it
+    };
+    
+    // How the --mirror copies of one download went, for its primary copy
+    struct mirrorResult {
+        std::vector<std::string> paths;
+        int failed = 0;
+    };
 
     
+    // Called for each file on the card: the item, its info, and the folder it's in.
+    // Return true to keep the item
+    typedef std::function<bool(EdsDirectoryItemRef, const EdsDirectoryItemInfo&, const std::string&)> cardVisitor;
+    
     class Session {
         
     private:
@@ -44,9 +125,55 @@ namespace cc {
         bool sdkInitialized;
         EdsCameraRef camera = NULL;
         bool sessionOpen = false;
-        std::string outfile;
-        std::vector<command> command_queue;
+        std::deque<request> command_queue;
         std::mutex command_queue_mutex;
+        std::condition_variable command_queue_cv;
+        
+        std::deque<capture> captures;   // oldest first
+        capture current;                // the capture being downloaded
+        Catalog catalog;                // every finalized download, for "captures"
+        Journal journal;                // downloads started but not finalized
+        SyncIndex synced;               // files already pulled off the card, for "sync"
+        std::deque<std::pair<EdsDirectoryItemRef, capture>> cardQueue;  // already on the card: crash resumes, then ingests
+        std::shared_ptr<ingestJob> ingesting;   // the last "ingest"
+        time_point recordStarted;
+        bool recording = false;         // as far as our own commands know. "state" still asks the camera
+        StatusPage statusPage;
+        FrameRing frameRing;
+        bool motionRecording = false;   // the current recording was started by the motion detector
+        std::vector<std::pair<std::string, request>> watchers;  // topic, "watch" request
+        ProxyRecorder proxyRecorder;
+        bool liveViewRequested = false; // "liveview on" holds one retain, however many times it's sent
+        std::string serial;             // cached at open() for file names
+        SequenceCounter sequence;       // {seq}, persisted per camera
+        uint64_t recordSeq = 0;         // {seq} and time of the recording in progress,
+        int64_t recordEpochMs = 0;      // shared by its proxy and its clip
+        bool diskWarned = false;        // about the recording in progress running out of space
+        int64_t reportedClusters = -1;  // last EdsSetCapacity
+        Tee tee{DOWNLOAD_CHUNK_SIZE};   // download chunks, and the threads writing them
+        EdsStreamRef chunkStreams[TEE_BUFFERS] = {};    // over the tee's buffers
+        int lastProgress;
+        
+        void execute(request& req);
+        void respond(const request& req, const std::string& status, const std::string& message, bool done=true);
+        void reportError(const std::string& message);
+        void publishState();
+        uint64_t pendingBytes(bool includeRecording=true);
+        void reportCapacity(bool force=false);
+        bool admitRecording(std::string& message);
+        void finishDownload(const capture& cap, EdsDirectoryItemRef item, const EdsDirectoryItemInfo& info, const std::string& path, uint64_t hash, std::shared_ptr<mirrorResult> mirrored, const std::string& error);
+        void walkCard(const cardVisitor& visit);
+        void walkFolder(EdsBaseRef parent, const std::string& folder, const cardVisitor& visit);
+        std::string cardFolder(EdsDirectoryItemRef item);
+        void resumeJournal();
+        void settle(const capture& cap, bool ok, uint64_t bytes);
+        void reportIngest(ingestJob& job);
+        void finalizeMirror(const request& req, TeeTarget& target, std::shared_ptr<mirrorResult> mirrored);
+        std::string saveThumbnail(EdsDirectoryItemRef item, const std::string& path);
+        void analyze(const Frame& frame);
+        bool watched(const std::string& topic);
+        const char* renderPath(PathTemplate& tmpl, const char* ext, const char* name, uint64_t seq, int64_t epochMs, const char* dir=NULL);
+        void broadcast(const std::string& topic, const nlohmann::json& body);
         
         
         time_point start;
@@ -63,6 +190,7 @@ namespace cc {
         std::string getDevicesAsJSON();
         
         EdsError download(EdsBaseRef object);
+        EdsError EDSCALLBACK handleProgress(EdsUInt32 percent);
         EdsError EDSCALLBACK handleEvent(EdsObjectEvent event, EdsBaseRef object);
         EdsError EDSCALLBACK handleProperty(EdsPropertyEvent event, EdsPropertyID propertyId, EdsUInt32 param);
         EdsError EDSCALLBACK handleState(EdsStateEvent event, EdsUInt32 param);
@@ -73,26 +201,36 @@ namespace cc {
         
         std::string getSerial();
         
-        void addCommand(command cmd) {
-           command_queue_mutex.lock();
-           command_queue.push_back(cmd);
-           command_queue_mutex.unlock();
-        }
-
-        static bool fileExists(const std::string& filename) {
-            struct stat buf;
-            if (stat(filename.c_str(), &buf) != -1) return true;
-            return false;
-        }
+        static command parseCommand(std::string input);
+        
+        void addCommand(command cmd, responder respond = responder(), connection connected = connection());
+        
+        // Sleep until a command is queued or the timeout passes
+        void waitForCommands(milliseconds timeout);
+        
+        // How long the camera loop may sleep before process() has work to do
+        milliseconds idleTime();
+        
+        LiveView liveView;
+        MotionDetector motion;
+        ExposureMeter exposure;
+        FocusMeter focus;
 
         int maxDuration;
         bool downloading;
         bool deleteAfterDownload;
         bool saveToHost;
         bool overwrite;
-        bool canceled = false;
         EdsInt32 cameraIndex;
         std::string defaultDir;
+        std::vector<std::string> mirrors;   // more folders every download is written to
+        bool shareFrames = false;       // publish live view to the shared memory frame ring
+        int shareFramesWidth = 0;       // and decoded RGB frames at this width, if > 0
+        bool recordProxy = false;       // write live view to an MJPEG AVI while recording
+        bool thumbnails = false;        // save each capture's thumbnail ahead of its download
+        PathTemplate pathTemplate;      // default output names
+        Finalizer finalizer;            // .part renames and the fsync policy
+        DiskSpace disk;                 // free space under defaultDir, and whether a clip fits
     };
     
 
@@ -0,0 +1,314 @@
+//
+//  Simd.cpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#include "Simd.hpp"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SIMD_X86 1
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace cc {
+    namespace simd {
+        
+        // ----------------------------------------------------------------------
+        uint64_t sadScalar(const uint8_t* a, const uint8_t* b, size_t n) {
+            uint64_t sum = 0;
+            for(size_t i=0; i<n; ++i) {
+                sum += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+            }
+            return sum;
+        }
+        
+        // ----------------------------------------------------------------------
+        void lumaScalar(const uint8_t* rgb, uint8_t* y, size_t pixels) {
+            for(size_t i=0; i<pixels; ++i, rgb += 3) {
+                y[i] = (uint8_t)((77*rgb[0] + 150*rgb[1] + 29*rgb[2] + 128) >> 8);
+            }
+        }
+        
+        // ----------------------------------------------------------------------
+        void histogram(const uint8_t* data, size_t n, uint32_t* hist) {
+            uint32_t banks[4][256];
+            memset(banks, 0, sizeof(banks));
+            size_t i = 0;
+            for(; i+4 <= n; i += 4) {
+                banks[0][data[i]]++;
+                banks[1][data[i+1]]++;
+                banks[2][data[i+2]]++;
+                banks[3][data[i+3]]++;
+            }
+            for(; i<n; ++i) banks[0][data[i]]++;
+            for(int v=0; v<256; ++v) {
+                hist[v] += banks[0][v] + banks[1][v] + banks[2][v] + banks[3][v];
+            }
+        }
+        
+        // ----------------------------------------------------------------------
+        void histogramRGB(const uint8_t* rgb, size_t pixels, uint32_t* r, uint32_t* g, uint32_t* b) {
+            uint32_t banks[2][3][256];
+            memset(banks, 0, sizeof(banks));
+            size_t i = 0;
+            for(; i+2 <= pixels; i += 2, rgb += 6) {
+                banks[0][0][rgb[0]]++;
+                banks[0][1][rgb[1]]++;
+                banks[0][2][rgb[2]]++;
+                banks[1][0][rgb[3]]++;
+                banks[1][1][rgb[4]]++;
+                banks[1][2][rgb[5]]++;
+            }
+            if(i < pixels) {
+                banks[0][0][rgb[0]]++;
+                banks[0][1][rgb[1]]++;
+                banks[0][2][rgb[2]]++;
+            }
+            for(int v=0; v<256; ++v) {
+                r[v] += banks[0][0][v] + banks[1][0][v];
+                g[v] += banks[0][1][v] + banks[1][1][v];
+                b[v] += banks[0][2][v] + banks[1][2][v];
+            }
+        }
+        
+        // ----------------------------------------------------------------------
+        void laplacianScalar(const uint8_t* p, ptrdiff_t stride, int width, int height, int64_t* sum, uint64_t* sumSq) {
+            int64_t s = 0;
+            uint64_t sq = 0;
+            for(int y=0; y<height; ++y, p += stride) {
+                for(int x=0; x<width; ++x) {
+                    int l = 4*p[x] - p[x-1] - p[x+1] - p[x-stride] - p[x+stride];
+                    s += l;
+                    sq += (uint64_t)(l*l);
+                }
+            }
+            *sum += s;
+            *sumSq += sq;
+        }
+        
+#if SIMD_X86
+        
+        // ----------------------------------------------------------------------
+        static uint64_t sadSSE2(const uint8_t* a, const uint8_t* b, size_t n) {
+            __m128i acc = _mm_setzero_si128();
+            size_t i = 0;
+            for(; i+16 <= n; i += 16) {
+                __m128i x = _mm_loadu_si128((const __m128i*)(a+i));
+                __m128i y = _mm_loadu_si128((const __m128i*)(b+i));
+                acc = _mm_add_epi64(acc, _mm_sad_epu8(x, y));
+            }
+            uint64_t lanes[2];
+            _mm_storeu_si128((__m128i*)lanes, acc);
+            return lanes[0] + lanes[1] + sadScalar(a+i, b+i, n-i);
+        }
+        
+        // ----------------------------------------------------------------------
+        __attribute__((target("avx2")))
+        static uint64_t sadAVX2(const uint8_t* a, const uint8_t* b, size_t n) {
+            __m256i acc = _mm256_setzero_si256();
+            size_t i = 0;
+            for(; i+32 <= n; i += 32) {
+                __m256i x = _mm256_loadu_si256((const __m256i*)(a+i));
+                __m256i y = _mm256_loadu_si256((const __m256i*)(b+i));
+                acc = _mm256_add_epi64(acc, _mm256_sad_epu8(x, y));
+            }
+            uint64_t lanes[4];
+            _mm256_storeu_si256((__m256i*)lanes, acc);
+            return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sadSSE2(a+i, b+i, n-i);
+        }
+        
+        static bool hasAVX2() {
+            static const bool avx2 = __builtin_cpu_supports("avx2");
+            return avx2;
+        }
+        
+        // ----------------------------------------------------------------------
+        uint64_t sad(const uint8_t* a, const uint8_t* b, size_t n) {
+            return hasAVX2() ? sadAVX2(a, b, n) : sadSSE2(a, b, n);
+        }
+        
+        // ----------------------------------------------------------------------
+        // 16 pixels at a time: pshufb pulls each channel out of the three loads,
+        // then 16 bit multiply-adds.
+        __attribute__((target("ssse3")))
+        static void lumaSSSE3(const uint8_t* rgb, uint8_t* y, size_t pixels) {
+            const char X = (char)0x80;
+            const __m128i r0 = _mm_setr_epi8(0,3,6,9,12,15, X,X,X,X,X,X,X,X,X,X);
+            const __m128i r1 = _mm_setr_epi8(X,X,X,X,X,X, 2,5,8,11,14, X,X,X,X,X);
+            const __m128i r2 = _mm_setr_epi8(X,X,X,X,X,X,X,X,X,X,X, 1,4,7,10,13);
+            const __m128i g0 = _mm_setr_epi8(1,4,7,10,13, X,X,X,X,X,X,X,X,X,X,X);
+            const __m128i g1 = _mm_setr_epi8(X,X,X,X,X, 0,3,6,9,12,15, X,X,X,X,X);
+            const __m128i g2 = _mm_setr_epi8(X,X,X,X,X,X,X,X,X,X,X, 2,5,8,11,14);
+            const __m128i b0 = _mm_setr_epi8(2,5,8,11,14, X,X,X,X,X,X,X,X,X,X,X);
+            const __m128i b1 = _mm_setr_epi8(X,X,X,X,X, 1,4,7,10,13, X,X,X,X,X,X);
+            const __m128i b2 = _mm_setr_epi8(X,X,X,X,X,X,X,X,X,X, 0,3,6,9,12,15);
+            const __m128i kr = _mm_set1_epi16(77), kg = _mm_set1_epi16(150), kb = _mm_set1_epi16(29);
+            const __m128i round = _mm_set1_epi16(128);
+            const __m128i zero = _mm_setzero_si128();
+            
+            size_t i = 0;
+            for(; i+16 <= pixels; i += 16, rgb += 48) {
+                __m128i a = _mm_loadu_si128((const __m128i*)rgb);
+                __m128i b = _mm_loadu_si128((const __m128i*)(rgb+16));
+                __m128i c = _mm_loadu_si128((const __m128i*)(rgb+32));
+                __m128i R = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, r0), _mm_shuffle_epi8(b, r1)), _mm_shuffle_epi8(c, r2));
+                __m128i G = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, g0), _mm_shuffle_epi8(b, g1)), _mm_shuffle_epi8(c, g2));
+                __m128i B = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, b0), _mm_shuffle_epi8(b, b1)), _mm_shuffle_epi8(c, b2));
+                
+                // Sums stay under 65536, so unsigned wraparound in 16 bits is fine
+                __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(R, zero), kr),
+                                                         _mm_mullo_epi16(_mm_unpacklo_epi8(G, zero), kg)),
+                                           _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(B, zero), kb), round));
+                __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(R, zero), kr),
+                                                         _mm_mullo_epi16(_mm_unpackhi_epi8(G, zero), kg)),
+                                           _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(B, zero), kb), round));
+                __m128i out = _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+                _mm_storeu_si128((__m128i*)(y+i), out);
+            }
+            lumaScalar(rgb, y+i, pixels-i);
+        }
+        
+        // ----------------------------------------------------------------------
+        // 8 pixels at a time in 16 bits (|l| <= 1020); madd squares and sums
+        // pairs into 32 bit lanes, which are flushed to 64 bits every row.
+        static void laplacianSSE2(const uint8_t* p, ptrdiff_t stride, int width, int height, int64_t* sum, uint64_t* sumSq) {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i ones = _mm_set1_epi16(1);
+            int64_t s = 0;
+            uint64_t sq = 0;
+            int x;
+            for(int y=0; y<height; ++y, p += stride) {
+                __m128i rowSum = _mm_setzero_si128();
+                __m128i rowSq = _mm_setzero_si128();
+                for(x=0; x+8 <= width; x += 8) {
+                    __m128i c = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(p+x)), zero);
+                    __m128i l = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(p+x-1)), zero);
+                    __m128i r = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(p+x+1)), zero);
+                    __m128i u = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(p+x-stride)), zero);
+                    __m128i d = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(p+x+stride)), zero);
+                    __m128i lap = _mm_sub_epi16(_mm_slli_epi16(c, 2), _mm_add_epi16(_mm_add_epi16(l, r), _mm_add_epi16(u, d)));
+                    rowSum = _mm_add_epi32(rowSum, _mm_madd_epi16(lap, ones));
+                    rowSq = _mm_add_epi32(rowSq, _mm_madd_epi16(lap, lap));
+                }
+                int32_t a[4], b[4];
+                _mm_storeu_si128((__m128i*)a, rowSum);
+                _mm_storeu_si128((__m128i*)b, rowSq);
+                s += (int64_t)a[0] + a[1] + a[2] + a[3];
+                sq += (uint64_t)(uint32_t)b[0] + (uint32_t)b[1] + (uint32_t)b[2] + (uint32_t)b[3];
+                if(x < width) laplacianScalar(p+x, stride, width-x, 1, &s, &sq);
+            }
+            *sum += s;
+            *sumSq += sq;
+        }
+        
+        // ----------------------------------------------------------------------
+        void laplacian(const uint8_t* p, ptrdiff_t stride, int width, int height, int64_t* sum, uint64_t* sumSq) {
+            laplacianSSE2(p, stride, width, height, sum, sumSq);
+        }
+        
+        static bool hasSSSE3() {
+            static const bool ssse3 = __builtin_cpu_supports("ssse3");
+            return ssse3;
+        }
+        
+        // ----------------------------------------------------------------------
+        void luma(const uint8_t* rgb, uint8_t* y, size_t pixels) {
+            if(hasSSSE3()) lumaSSSE3(rgb, y, pixels);
+            else lumaScalar(rgb, y, pixels);
+        }
+        
+        const char* isa() {
+            return hasAVX2() ? "avx2" : "sse2";
+        }
+        
+#elif SIMD_NEON
+        
+        // ----------------------------------------------------------------------
+        uint64_t sad(const uint8_t* a, const uint8_t* b, size_t n) {
+            uint64x2_t acc = vdupq_n_u64(0);
+            size_t i = 0;
+            for(; i+16 <= n; i += 16) {
+                uint8x16_t d = vabdq_u8(vld1q_u8(a+i), vld1q_u8(b+i));
+                acc = vaddq_u64(acc, vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(d))));
+            }
+            return vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1) + sadScalar(a+i, b+i, n-i);
+        }
+        
+        // ----------------------------------------------------------------------
+        void luma(const uint8_t* rgb, uint8_t* y, size_t pixels) {
+            const uint8x8_t kr = vdup_n_u8(77), kg = vdup_n_u8(150), kb = vdup_n_u8(29);
+            size_t i = 0;
+            for(; i+16 <= pixels; i += 16, rgb += 48) {
+                uint8x16x3_t px = vld3q_u8(rgb);
+                uint16x8_t lo = vmull_u8(vget_low_u8(px.val[0]), kr);
+                lo = vmlal_u8(lo, vget_low_u8(px.val[1]), kg);
+                lo = vmlal_u8(lo, vget_low_u8(px.val[2]), kb);
+                uint16x8_t hi = vmull_u8(vget_high_u8(px.val[0]), kr);
+                hi = vmlal_u8(hi, vget_high_u8(px.val[1]), kg);
+                hi = vmlal_u8(hi, vget_high_u8(px.val[2]), kb);
+                vst1q_u8(y+i, vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8)));
+            }
+            lumaScalar(rgb, y+i, pixels-i);
+        }
+        
+        // ----------------------------------------------------------------------
+        void laplacian(const uint8_t* p, ptrdiff_t stride, int width, int height, int64_t* sum, uint64_t* sumSq) {
+            int64_t s = 0;
+            uint64_t sq = 0;
+            int x;
+            for(int y=0; y<height; ++y, p += stride) {
+                int32x4_t rowSum = vdupq_n_s32(0);
+                uint32x4_t rowSq = vdupq_n_u32(0);
+                for(x=0; x+8 <= width; x += 8) {
+                    int16x8_t c = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(p+x)));
+                    int16x8_t n = vreinterpretq_s16_u16(vaddq_u16(vaddl_u8(vld1_u8(p+x-1), vld1_u8(p+x+1)),
+                                                                  vaddl_u8(vld1_u8(p+x-stride), vld1_u8(p+x+stride))));
+                    int16x8_t lap = vsubq_s16(vshlq_n_s16(c, 2), n);
+                    rowSum = vpadalq_s16(rowSum, lap);
+                    int16x8_t mag = vabsq_s16(lap);
+                    rowSq = vmlal_u16(rowSq, vget_low_u16(vreinterpretq_u16_s16(mag)), vget_low_u16(vreinterpretq_u16_s16(mag)));
+                    rowSq = vmlal_u16(rowSq, vget_high_u16(vreinterpretq_u16_s16(mag)), vget_high_u16(vreinterpretq_u16_s16(mag)));
+                }
+                s += (int64_t)vgetq_lane_s32(rowSum, 0) + vgetq_lane_s32(rowSum, 1) + vgetq_lane_s32(rowSum, 2) + vgetq_lane_s32(rowSum, 3);
+                sq += (uint64_t)vgetq_lane_u32(rowSq, 0) + vgetq_lane_u32(rowSq, 1) + vgetq_lane_u32(rowSq, 2) + vgetq_lane_u32(rowSq, 3);
+                if(x < width) laplacianScalar(p+x, stride, width-x, 1, &s, &sq);
+            }
+            *sum += s;
+            *sumSq += sq;
+        }
+        
+        const char* isa() {
+            return "neon";
+        }
+        
+#else
+        
+        // ----------------------------------------------------------------------
+        uint64_t sad(const uint8_t* a, const uint8_t* b, size_t n) {
+            return sadScalar(a, b, n);
+        }
+        
+        void luma(const uint8_t* rgb, uint8_t* y, size_t pixels) {
+            lumaScalar(rgb, y, pixels);
+        }
+        
+        void laplacian(const uint8_t* p, ptrdiff_t stride, int width, int height, int64_t* sum, uint64_t* sumSq) {
+            laplacianScalar(p, stride, width, height, sum, sumSq);
+        }
+        
+        const char* isa() {
+            return "scalar";
+        }
+        
+#endif
+    }
+}
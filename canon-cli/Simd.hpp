@@ -0,0 +1,46 @@
+//
+//  Simd.hpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace cc {
+    
+    //
+    //  Pixel kernels for live view analysis. Each has a scalar version and
+    //  SSE2/AVX2 (x86) or NEON (ARM) versions; AVX2 is picked at runtime since
+    //  we don't build for it by default.
+    //
+    namespace simd {
+        
+        // Sum of absolute differences of two byte runs
+        uint64_t sad(const uint8_t* a, const uint8_t* b, size_t n);
+        uint64_t sadScalar(const uint8_t* a, const uint8_t* b, size_t n);
+        
+        // BT.601 luma of packed RGB: (77R + 150G + 29B + 128) >> 8
+        void luma(const uint8_t* rgb, uint8_t* y, size_t pixels);
+        void lumaScalar(const uint8_t* rgb, uint8_t* y, size_t pixels);
+        
+        // Adds counts of each byte value to hist[256]. Scalar, but spread over
+        // four tables so repeated values don't serialize on one counter.
+        void histogram(const uint8_t* data, size_t n, uint32_t* hist);
+        
+        // Same for packed RGB, one table per channel
+        void histogramRGB(const uint8_t* rgb, size_t pixels, uint32_t* r, uint32_t* g, uint32_t* b);
+        
+        // Sum and sum of squares of the 4-neighbour Laplacian of a luma region.
+        // p is the region's first pixel; the pixels around the region must be
+        // readable too, so keep it one pixel inside the image.
+        void laplacian(const uint8_t* p, ptrdiff_t stride, int width, int height, int64_t* sum, uint64_t* sumSq);
+        void laplacianScalar(const uint8_t* p, ptrdiff_t stride, int width, int height, int64_t* sum, uint64_t* sumSq);
+        
+        // Which implementation the kernels ended up with, for logs
+        const char* isa();
+    }
+}
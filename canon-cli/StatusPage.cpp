@@ -0,0 +1,173 @@
+//
+//  StatusPage.cpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#include "StatusPage.hpp"
+#include "Logger.hpp"
+#include "json.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <chrono>
+#include <atomic>
+#include <sstream>
+#include <algorithm>
+
+using json = nlohmann::json;
+
+namespace cc {
+    
+    // ----------------------------------------------------------------------
+    StatusPage::StatusPage() {
+        memset(&scratch, 0, sizeof(scratch));
+    }
+    
+    // ----------------------------------------------------------------------
+    StatusPage::~StatusPage() {
+        close();
+    }
+    
+    // ----------------------------------------------------------------------
+    std::string StatusPage::pageName(int32_t cameraIndex) {
+        std::stringstream ss;
+        ss << "/canon-cli-" << cameraIndex;
+        return ss.str();
+    }
+    
+    // ----------------------------------------------------------------------
+    int64_t StatusPage::now() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+    
+    // ----------------------------------------------------------------------
+    void StatusPage::copy(char* dst, const std::string& src, size_t size) {
+        size_t n = std::min(src.size(), size-1);
+        memcpy(dst, src.data(), n);
+        dst[n] = 0;
+    }
+    
+    // ----------------------------------------------------------------------
+    void StatusPage::open(int32_t cameraIndex) {
+        if(data) return;
+        name = pageName(cameraIndex);
+        
+        // A page left behind by a crashed run of an older build may be smaller
+        shm_unlink(name.c_str());
+        int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+        if(fd < 0) {
+            Logger::getInstance()->warning("can't create status page "+name+": "+strerror(errno));
+            return;
+        }
+        if(ftruncate(fd, sizeof(StatusData)) < 0 && errno != EINVAL) { // macOS refuses to resize an existing object
+            Logger::getInstance()->warning("can't size status page "+name+": "+strerror(errno));
+            ::close(fd);
+            return;
+        }
+        void* p = mmap(NULL, sizeof(StatusData), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(p == MAP_FAILED) {
+            Logger::getInstance()->warning("can't map status page "+name+": "+strerror(errno));
+            return;
+        }
+        
+        data = (StatusData*)p;
+        memset(data, 0, sizeof(StatusData));
+        data->magic = STATUS_PAGE_MAGIC;
+        data->version = STATUS_PAGE_VERSION;
+        data->pid = getpid();
+        data->cameraIndex = cameraIndex;
+        data->updated = now();
+        Logger::getInstance()->status("publishing status on "+name);
+    }
+    
+    // ----------------------------------------------------------------------
+    void StatusPage::close() {
+        if(!data) return;
+        munmap(data, sizeof(StatusData));
+        shm_unlink(name.c_str());
+        data = NULL;
+    }
+    
+    // ----------------------------------------------------------------------
+    StatusData* StatusPage::begin() {
+        if(!data) return &scratch;
+        uint32_t seq = __atomic_load_n(&data->sequence, __ATOMIC_RELAXED);
+        __atomic_store_n(&data->sequence, seq+1, __ATOMIC_RELAXED);
+        std::atomic_thread_fence(std::memory_order_release);
+        return data;
+    }
+    
+    // ----------------------------------------------------------------------
+    void StatusPage::end() {
+        if(!data) return;
+        data->updated = now();
+        uint32_t seq = __atomic_load_n(&data->sequence, __ATOMIC_RELAXED);
+        __atomic_store_n(&data->sequence, seq+1, __ATOMIC_RELEASE);
+    }
+    
+    // ----------------------------------------------------------------------
+    void StatusPage::setQueueDepth(uint32_t depth) {
+        __atomic_store_n(data ? &data->queueDepth : &scratch.queueDepth, depth, __ATOMIC_RELAXED);
+    }
+    
+    // ----------------------------------------------------------------------
+    bool StatusPage::read(int32_t cameraIndex, StatusData& out) {
+        int fd = shm_open(pageName(cameraIndex).c_str(), O_RDONLY, 0);
+        if(fd < 0) return false;
+        void* p = mmap(NULL, sizeof(StatusData), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(p == MAP_FAILED) return false;
+        
+        // A long running monitor would keep the mapping and just loop here
+        const StatusData* page = (const StatusData*)p;
+        uint32_t before, after;
+        do {
+            before = __atomic_load_n(&page->sequence, __ATOMIC_ACQUIRE);
+            memcpy(&out, page, sizeof(StatusData));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = __atomic_load_n(&page->sequence, __ATOMIC_RELAXED);
+        } while((before & 1) || before != after);
+        
+        munmap(p, sizeof(StatusData));
+        return out.magic == STATUS_PAGE_MAGIC && out.version == STATUS_PAGE_VERSION;
+    }
+    
+    // ----------------------------------------------------------------------
+    std::string StatusPage::toJSON(const StatusData& status) {
+        static const char* states[] = { "closed", "open", "recording", "downloading" };
+        
+        json j;
+        j["pid"] = status.pid;
+        j["id"] = status.cameraIndex;
+        j["state"] = status.state >= 0 && status.state <= STATUS_DOWNLOADING ? states[status.state] : "unknown";
+        j["serial"] = std::string(status.serial, strnlen(status.serial, sizeof(status.serial)));
+        j["file"] = std::string(status.currentFile, strnlen(status.currentFile, sizeof(status.currentFile)));
+        j["bytesDownloaded"] = status.bytesDownloaded;
+        j["bytesTotal"] = status.bytesTotal;
+        j["downloadedTotal"] = status.downloadedTotal;
+        j["queueDepth"] = status.queueDepth;
+        j["commands"] = status.commands;
+        j["captures"] = status.captures;
+        j["errors"] = status.errors;
+        j["lastError"] = std::string(status.lastError, strnlen(status.lastError, sizeof(status.lastError)));
+        j["recordStarted"] = status.recordStarted;
+        j["updated"] = status.updated;
+        j["exposure"]["mean"] = status.exposureMean;
+        j["exposure"]["shadows"] = status.shadows;
+        j["exposure"]["highlights"] = status.highlights;
+        j["focus"] = status.focus;
+        j["liveview"]["fps"] = status.liveviewFps;
+        j["liveview"]["rate"] = status.liveviewRate;
+        j["liveview"]["latency"] = status.liveviewLatency;
+        j["disk"]["free"] = status.diskFree;
+        j["disk"]["remaining"] = status.diskRemaining;
+        return j.dump(4);
+    }
+}
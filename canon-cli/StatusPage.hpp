@@ -0,0 +1,91 @@
+//
+//  StatusPage.hpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#pragma once
+
+#include <string>
+#include <stdint.h>
+
+#define STATUS_PAGE_MAGIC 0x43414e4e // "CANN"
+#define STATUS_PAGE_VERSION 4
+
+#define STATUS_CLOSED 0
+#define STATUS_OPEN 1
+#define STATUS_RECORDING 2
+#define STATUS_DOWNLOADING 3
+
+namespace cc {
+    
+    //
+    //  Fixed layout status record published in POSIX shared memory as
+    //  "/canon-cli-<id>". Monitors map it read-only and copy it out under the
+    //  seqlock, so checking on a capture process costs no syscall and never
+    //  touches its threads. Plain C types only; don't reorder.
+    //
+    struct StatusData {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t sequence;          // seqlock. odd while an update is in progress
+        uint32_t queueDepth;        // atomic on its own; bumped from any thread
+        int32_t pid;
+        int32_t cameraIndex;
+        int32_t state;              // STATUS_*
+        int32_t reserved;
+        int64_t updated;            // ms since epoch
+        int64_t recordStarted;      // ms since epoch, 0 when not recording
+        uint64_t bytesDownloaded;   // current transfer
+        uint64_t bytesTotal;        // current transfer
+        uint64_t downloadedTotal;   // all transfers
+        uint64_t commands;
+        uint64_t captures;
+        uint64_t errors;
+        char serial[32];
+        char currentFile[256];
+        char lastError[256];
+        float exposureMean;         // live view luma, 0-255, while exposure metering is on
+        float shadows;              // % of pixels
+        float highlights;           // % of pixels
+        float focus;                // variance of Laplacian, while focus metering is on
+        float liveviewFps;          // achieved
+        float liveviewRate;         // what the adaptive loop is aiming for. 0 when idle
+        float liveviewLatency;      // ms per EdsDownloadEvfImage, moving average
+        float diskRemaining;        // seconds of video that still fit where downloads go
+        uint64_t diskFree;          // bytes
+    };
+    
+    class StatusPage {
+        
+    private:
+        std::string name;
+        StatusData* data = NULL;
+        StatusData scratch;         // written to when the page couldn't be mapped
+        
+    public:
+        StatusPage();
+        ~StatusPage();
+        
+        static std::string pageName(int32_t cameraIndex);
+        
+        // Create and map the page. Failure is logged, not thrown; updates then go nowhere.
+        void open(int32_t cameraIndex);
+        void close();
+        
+        // Writer side, session thread only:
+        //   StatusData* s = page.begin(); s->state = STATUS_OPEN; page.end();
+        StatusData* begin();
+        void end();
+        
+        void setQueueDepth(uint32_t depth);
+        
+        static void copy(char* dst, const std::string& src, size_t size);
+        static int64_t now();
+        
+        // Reader side, for monitors. Returns false if no process publishes that page.
+        static bool read(int32_t cameraIndex, StatusData& out);
+        static std::string toJSON(const StatusData& status);
+    };
+}
@@ -0,0 +1,113 @@
+//
+//  SyncIndex.cpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#include "SyncIndex.hpp"
+#include "Catalog.hpp"
+#include "Logger.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <vector>
+#include <sstream>
+
+namespace cc {
+    
+    // ----------------------------------------------------------------------
+    SyncIndex::~SyncIndex() {
+        close();
+    }
+    
+    // ----------------------------------------------------------------------
+    std::string SyncIndex::defaultPath(const std::string& dir, const std::string& serial) {
+        return (dir.empty() ? "." : dir) + "/.canon-cli-" + (serial.empty() ? "camera" : serial) + ".synced";
+    }
+    
+    // ----------------------------------------------------------------------
+    void SyncIndex::open(const std::string& path) {
+        close();
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if(fd < 0) {
+            Logger::getInstance()->warning("can't open sync index "+path+": "+strerror(errno));
+            return;
+        }
+        
+        Header header;
+        ssize_t n = pread(fd, &header, sizeof(header), 0);
+        if(n == sizeof(header) && (header.magic != SYNC_INDEX_MAGIC || header.version != SYNC_INDEX_VERSION || header.recordSize != sizeof(SyncRecord))) {
+            Logger::getInstance()->warning("ignoring sync index "+path+" from another version");
+            n = 0;
+        }
+        if(n != sizeof(header)) {
+            memset(&header, 0, sizeof(header));
+            header.magic = SYNC_INDEX_MAGIC;
+            header.version = SYNC_INDEX_VERSION;
+            header.recordSize = sizeof(SyncRecord);
+            if(ftruncate(fd, 0) < 0 || pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+                Logger::getInstance()->warning("can't write sync index "+path+": "+strerror(errno));
+                close();
+                return;
+            }
+        }
+        
+        // Read in big blocks; a full card is tens of thousands of records.
+        // A record cut short by a crash is dropped, and overwritten by the next
+        std::vector<SyncRecord> block(1024);
+        off_t offset = sizeof(Header);
+        while((n = pread(fd, block.data(), block.size() * sizeof(SyncRecord), offset)) >= (ssize_t)sizeof(SyncRecord)) {
+            size_t count = n / sizeof(SyncRecord);
+            for(size_t i = 0; i < count; i++) {
+                const SyncRecord& r = block[i];
+                std::string key = std::string(r.folder, strnlen(r.folder, sizeof(r.folder))) + "/" + std::string(r.name, strnlen(r.name, sizeof(r.name)));
+                files[key] = Seen{r.size, r.dateTime};
+            }
+            offset += count * sizeof(SyncRecord);
+        }
+        if(lseek(fd, offset, SEEK_SET) < 0 || ftruncate(fd, offset) < 0) {
+            Logger::getInstance()->warning("can't trim sync index "+path+": "+strerror(errno));
+        }
+        
+        std::stringstream ss;
+        ss << "sync index " << path << " has " << files.size() << " files";
+        Logger::getInstance()->status(ss.str());
+    }
+    
+    // ----------------------------------------------------------------------
+    void SyncIndex::close() {
+        if(fd >= 0) ::close(fd);
+        fd = -1;
+        files.clear();
+    }
+    
+    // ----------------------------------------------------------------------
+    void SyncIndex::add(const std::string& folder, const std::string& name, uint64_t size, uint32_t dateTime) {
+        files[folder+"/"+name] = Seen{size, dateTime};
+        if(fd < 0) return;
+        
+        SyncRecord r;
+        memset(&r, 0, sizeof(r));
+        r.size = size;
+        r.dateTime = dateTime;
+        Catalog::copy(r.folder, folder, sizeof(r.folder));
+        Catalog::copy(r.name, name, sizeof(r.name));
+        if(::write(fd, &r, sizeof(r)) != sizeof(r)) {
+            Logger::getInstance()->warning(std::string("can't write sync index: ")+strerror(errno));
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    bool SyncIndex::contains(const std::string& folder, const std::string& name, uint64_t size, uint32_t dateTime) const {
+        auto it = files.find(folder+"/"+name);
+        return it != files.end() && it->second.size == size && it->second.dateTime == dateTime;
+    }
+    
+    // ----------------------------------------------------------------------
+    bool SyncIndex::seen(const std::string& folder, const std::string& name) const {
+        return files.count(folder+"/"+name) > 0;
+    }
+}
@@ -0,0 +1,69 @@
+//
+//  SyncIndex.hpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <stdint.h>
+
+#define SYNC_INDEX_MAGIC 0x58494e43   // "CNIX"
+#define SYNC_INDEX_VERSION 1
+
+namespace cc {
+    
+    // A file pulled off the card, as the card described it
+    struct SyncRecord {
+        uint64_t size;
+        uint32_t dateTime;
+        uint32_t reserved;
+        char folder[184];       // volume label and folders, like CARD/DCIM/100CANON
+        char name[64];
+    };
+    
+    //
+    //  What "ingest" and "sync" have already downloaded from a camera's card,
+    //  so "sync" only has to compare the card's listing against it. Records are
+    //  appended to a file next to the downloads as files are finalized; a file
+    //  that changed on the card gets a new record, and the last one wins.
+    //
+    class SyncIndex {
+        
+    private:
+        struct Header {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t recordSize;
+            uint32_t reserved;
+        };
+        
+        struct Seen {
+            uint64_t size;
+            uint32_t dateTime;
+        };
+        
+        int fd = -1;
+        std::unordered_map<std::string, Seen> files;    // folder/name
+        
+    public:
+        ~SyncIndex();
+        
+        static std::string defaultPath(const std::string& dir, const std::string& serial);
+        
+        // Failure is logged; the index only lasts for this run then
+        void open(const std::string& path);
+        void close();
+        
+        void add(const std::string& folder, const std::string& name, uint64_t size, uint32_t dateTime);
+        
+        // Downloaded already, and unchanged since
+        bool contains(const std::string& folder, const std::string& name, uint64_t size, uint32_t dateTime) const;
+        // Downloaded at some point, whatever it looks like now
+        bool seen(const std::string& folder, const std::string& name) const;
+        size_t size() const { return files.size(); }
+    };
+}
@@ -0,0 +1,151 @@
+//
+//  Tee.cpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#include "Tee.hpp"
+
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+
+namespace cc {
+    
+    // ----------------------------------------------------------------------
+    Tee::Tee(size_t size) : chunkSize(size), memory(size * TEE_BUFFERS) {
+    }
+    
+    // ----------------------------------------------------------------------
+    Tee::~Tee() {
+        if(!destinations.empty()) end();
+    }
+    
+    // ----------------------------------------------------------------------
+    void Tee::begin(const std::vector<TeeTarget>& targets) {
+        if(!destinations.empty()) end();
+        finishing = false;
+        next = 0;
+        mirrorStall = std::chrono::steady_clock::duration::zero();
+        for(Chunk& c : chunks) c = Chunk();
+        
+        for(const TeeTarget& t : targets) {
+            Destination* d = new Destination();
+            d->target = t;
+            destinations.push_back(std::unique_ptr<Destination>(d));
+        }
+        for(auto& d : destinations) {
+            d->thread = std::thread(&Tee::run, this, d.get());
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    int Tee::acquire() {
+        std::unique_lock<std::mutex> lock(mutex);
+        int i = next;
+        const std::chrono::steady_clock::duration budget = std::chrono::milliseconds(TEE_MIRROR_STALL);
+        while(chunks[i].readers > 0) {
+            if(destinations.empty() || holds(destinations[0].get(), i)) {
+                cv.wait(lock);
+            } else if(mirrorStall < budget) {
+                std::chrono::steady_clock::time_point waited = std::chrono::steady_clock::now();
+                cv.wait_for(lock, budget - mirrorStall);
+                mirrorStall += std::chrono::steady_clock::now() - waited;
+            } else {
+                // Out of patience: whoever still has this one is a whole ring behind.
+                // Their queued chunks are given back now, one being written when it's done
+                for(size_t n = 1; n < destinations.size(); n++) {
+                    Destination* d = destinations[n].get();
+                    if(!d->target.error.empty() || !holds(d, i)) continue;
+                    d->target.error = "fell behind";
+                    for(int q : d->queue) chunks[q].readers--;
+                    d->queue.clear();
+                }
+                if(chunks[i].readers > 0) cv.wait(lock);
+            }
+        }
+        next = (next + 1) % TEE_BUFFERS;
+        return i;
+    }
+    
+    // ----------------------------------------------------------------------
+    // Whether a destination has yet to finish writing chunk i
+    bool Tee::holds(const Destination* d, int i) {
+        return d->writing == i || std::find(d->queue.begin(), d->queue.end(), i) != d->queue.end();
+    }
+    
+    // ----------------------------------------------------------------------
+    void Tee::commit(int i, size_t size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        chunks[i].size = size;
+        chunks[i].readers = (int)destinations.size();
+        for(auto& d : destinations) d->queue.push_back(i);
+        cv.notify_all();
+    }
+    
+    // ----------------------------------------------------------------------
+    size_t Tee::healthy() {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t n = 0;
+        for(auto& d : destinations) if(d->target.error.empty()) n++;
+        return n;
+    }
+    
+    // ----------------------------------------------------------------------
+    std::vector<TeeTarget> Tee::end() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finishing = true;
+            cv.notify_all();
+        }
+        std::vector<TeeTarget> targets;
+        for(auto& d : destinations) {
+            if(d->thread.joinable()) d->thread.join();
+            targets.push_back(d->target);
+        }
+        destinations.clear();
+        return targets;
+    }
+    
+    // ----------------------------------------------------------------------
+    void Tee::run(Destination* d) {
+        std::unique_lock<std::mutex> lock(mutex);
+        while(true) {
+            cv.wait(lock, [this, d]{ return !d->queue.empty() || finishing; });
+            if(d->queue.empty()) break;
+            int i = d->queue.front();
+            d->queue.pop_front();
+            d->writing = i;
+            bool ok = d->target.error.empty();
+            lock.unlock();
+            
+            // The buffer can't be refilled until readers drops to 0, so it's safe to read unlocked
+            std::string error;
+            if(ok) {
+                const char* p = buffer(i);
+                size_t left = chunks[i].size;
+                while(left > 0) {
+                    ssize_t w = write(d->target.fd, p, left);
+                    if(w < 0 && errno == EINTR) continue;
+                    if(w <= 0) {
+                        error = w < 0 ? strerror(errno) : "short write";
+                        break;
+                    }
+                    p += w;
+                    left -= w;
+                }
+            }
+            
+            lock.lock();
+            if(ok && d->target.error.empty()) {
+                if(error.empty()) d->target.written += chunks[i].size;
+                else d->target.error = error;
+            }
+            d->writing = -1;
+            chunks[i].readers--;
+            cv.notify_all();
+        }
+    }
+}
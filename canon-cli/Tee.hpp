@@ -0,0 +1,96 @@
+//
+//  Tee.hpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <chrono>
+#include <stdint.h>
+
+#define TEE_BUFFERS 4   // chunks in flight: one arriving from the camera, the rest being written
+#define TEE_MIRROR_STALL 1000   // ms a download may spend waiting on mirrors before they're dropped
+
+namespace cc {
+    
+    // One place a download goes
+    struct TeeTarget {
+        std::string path;           // final name, claimed already
+        std::string part;           // what's written to, renamed later
+        int fd = -1;
+        bool placeholder = false;   // we created the empty file holding path
+        std::string error;          // first write error. Later chunks are skipped
+        uint64_t written = 0;
+    };
+    
+    //
+    //  Fans one download out to several files, each written by its own thread
+    //  from the same chunk buffers. The camera fills buffer n+1 while buffer n
+    //  is still being written. A buffer is reused once every destination is
+    //  done with it, so the transfer can only go as fast as the slowest disk.
+    //  The first target (the primary) is always waited for. Mirrors get
+    //  TEE_MIRROR_STALL ms of holding up the camera per download, which rides
+    //  out a hiccup; after that, a mirror that still has every other buffer
+    //  queued (TEE_BUFFERS-1 chunks behind) fails with "fell behind" and the
+    //  rest carry on at full speed. A destination that has failed stops
+    //  holding buffers up.
+    //
+    //    int i = tee.acquire();        // a free buffer
+    //    ... fill tee.buffer(i) with n bytes ...
+    //    tee.commit(i, n);             // every destination writes it
+    //    targets = tee.end();          // wait for the writes; fds still open
+    //
+    class Tee {
+        
+    private:
+        struct Chunk {
+            size_t size = 0;
+            int readers = 0;            // destinations yet to write it
+        };
+        
+        struct Destination {
+            TeeTarget target;
+            std::deque<int> queue;
+            int writing = -1;           // the chunk its thread has, if any
+            std::thread thread;
+        };
+        
+        size_t chunkSize;
+        std::vector<char> memory;
+        Chunk chunks[TEE_BUFFERS];
+        int next = 0;
+        std::chrono::steady_clock::duration mirrorStall;    // this download's wait on mirrors alone
+        std::vector<std::unique_ptr<Destination>> destinations;
+        bool finishing = false;
+        std::mutex mutex;
+        std::condition_variable cv;
+        
+        void run(Destination* d);
+        bool holds(const Destination* d, int i);
+        
+    public:
+        explicit Tee(size_t chunkSize);
+        ~Tee();
+        
+        char* buffer(int i) { return &memory[i * chunkSize]; }
+        size_t capacity() { return chunkSize; }
+        
+        void begin(const std::vector<TeeTarget>& targets);
+        int acquire();
+        void commit(int i, size_t size);
+        
+        // Destinations that haven't failed yet
+        size_t healthy();
+        
+        std::vector<TeeTarget> end();
+    };
+}
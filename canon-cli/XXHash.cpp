@@ -0,0 +1,152 @@
+//
+//  XXHash.cpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#include "XXHash.hpp"
+
+#include <string.h>
+#include <stdio.h>
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+namespace cc {
+    
+    static inline uint64_t rotl(uint64_t x, int r) {
+        return (x << r) | (x >> (64 - r));
+    }
+    
+    // Both targets are little endian
+    static inline uint64_t read64(const unsigned char* p) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        return v;
+    }
+    
+    static inline uint32_t read32(const unsigned char* p) {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        return v;
+    }
+    
+    static inline uint64_t round(uint64_t acc, uint64_t input) {
+        acc += input * PRIME64_2;
+        acc = rotl(acc, 31);
+        return acc * PRIME64_1;
+    }
+    
+    static inline uint64_t merge(uint64_t acc, uint64_t v) {
+        acc ^= round(0, v);
+        return acc * PRIME64_1 + PRIME64_4;
+    }
+    
+    // ----------------------------------------------------------------------
+    XXHash64::XXHash64(uint64_t seed) {
+        reset(seed);
+    }
+    
+    // ----------------------------------------------------------------------
+    void XXHash64::reset(uint64_t s) {
+        seed = s;
+        v1 = seed + PRIME64_1 + PRIME64_2;
+        v2 = seed + PRIME64_2;
+        v3 = seed;
+        v4 = seed - PRIME64_1;
+        total = 0;
+        buffered = 0;
+    }
+    
+    // ----------------------------------------------------------------------
+    void XXHash64::update(const void* data, size_t size) {
+        const unsigned char* p = (const unsigned char*)data;
+        const unsigned char* end = p + size;
+        total += size;
+        
+        if(buffered + size < 32) {
+            memcpy(buffer + buffered, p, size);
+            buffered += size;
+            return;
+        }
+        if(buffered) {
+            size_t fill = 32 - buffered;
+            memcpy(buffer + buffered, p, fill);
+            v1 = round(v1, read64(buffer));
+            v2 = round(v2, read64(buffer+8));
+            v3 = round(v3, read64(buffer+16));
+            v4 = round(v4, read64(buffer+24));
+            p += fill;
+            buffered = 0;
+        }
+        while(p + 32 <= end) {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p+8));
+            v3 = round(v3, read64(p+16));
+            v4 = round(v4, read64(p+24));
+            p += 32;
+        }
+        if(p < end) {
+            buffered = end - p;
+            memcpy(buffer, p, buffered);
+        }
+    }
+    
+    // ----------------------------------------------------------------------
+    uint64_t XXHash64::digest() const {
+        uint64_t h;
+        if(total >= 32) {
+            h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+            h = merge(h, v1);
+            h = merge(h, v2);
+            h = merge(h, v3);
+            h = merge(h, v4);
+        } else {
+            h = seed + PRIME64_5;
+        }
+        h += total;
+        
+        const unsigned char* p = buffer;
+        const unsigned char* end = buffer + buffered;
+        while(p + 8 <= end) {
+            h ^= round(0, read64(p));
+            h = rotl(h, 27) * PRIME64_1 + PRIME64_4;
+            p += 8;
+        }
+        if(p + 4 <= end) {
+            h ^= (uint64_t)read32(p) * PRIME64_1;
+            h = rotl(h, 23) * PRIME64_2 + PRIME64_3;
+            p += 4;
+        }
+        while(p < end) {
+            h ^= (*p) * PRIME64_5;
+            h = rotl(h, 11) * PRIME64_1;
+            p++;
+        }
+        
+        h ^= h >> 33;
+        h *= PRIME64_2;
+        h ^= h >> 29;
+        h *= PRIME64_3;
+        h ^= h >> 32;
+        return h;
+    }
+    
+    // ----------------------------------------------------------------------
+    uint64_t XXHash64::hash(const void* data, size_t size, uint64_t seed) {
+        XXHash64 h(seed);
+        h.update(data, size);
+        return h.digest();
+    }
+    
+    // ----------------------------------------------------------------------
+    std::string XXHash64::hex(uint64_t hash) {
+        char s[17];
+        snprintf(s, sizeof(s), "%016llx", (unsigned long long)hash);
+        return s;
+    }
+}
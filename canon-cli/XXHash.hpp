@@ -0,0 +1,40 @@
+//
+//  XXHash.hpp
+//  canon-video-capture
+//
+//  Copyright © 2026 See-through Lab. All rights reserved.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+namespace cc {
+    
+    //
+    //  Streaming XXH64, fed chunk by chunk as a download comes in so the file
+    //  never has to be read back. Matches the reference implementation, so
+    //  `xxhsum -H64` on the result gives the same number.
+    //
+    class XXHash64 {
+        
+    private:
+        uint64_t v1, v2, v3, v4;
+        uint64_t seed;
+        uint64_t total;
+        unsigned char buffer[32];
+        size_t buffered;
+        
+    public:
+        XXHash64(uint64_t seed = 0);
+        
+        void reset(uint64_t seed = 0);
+        void update(const void* data, size_t size);
+        uint64_t digest() const;
+        
+        static uint64_t hash(const void* data, size_t size, uint64_t seed = 0);
+        static std::string hex(uint64_t hash);
+    };
+}
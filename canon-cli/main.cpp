@@ -10,12 +10,18 @@
 
 
 #include <thread>
+#include <csignal>
+#include <sstream>
 #include "cxxopts.hpp"
 
 #include "Logger.hpp"
 #include "Session.hpp"
+#include "ControlServer.hpp"
+#include "HttpServer.hpp"
+#include "MjpegServer.hpp"
+#include "ControlClient.hpp"
 
-bool sigint = false;
+std::atomic<bool> sigint(false);
 
 
 
@@ -29,9 +35,52 @@ bool sigint = false;
 
 int main(int argc, char * argv[]) {
     
+    // "canon-cli ctl ..." just talks to a running daemon. Don't start the SDK for that.
+    if(argc > 1 && strcmp(argv[1], "ctl")==0) {
+        return cc::ControlClient::run(argc-1, argv+1);
+    }
+    
+    // "canon-cli status [id]" reads a running process's shared memory status page
+    if(argc > 1 && strcmp(argv[1], "status")==0) {
+        cc::StatusData status;
+        if(!cc::StatusPage::read(argc > 2 ? atoi(argv[2]) : 0, status)) {
+            std::cerr << "no status page for camera " << (argc > 2 ? argv[2] : "0") << std::endl;
+            return 1;
+        }
+        std::cout << cc::StatusPage::toJSON(status) << std::endl;
+        return 0;
+    }
+    
+    // "canon-cli frames [id]" follows a running process's shared memory frame ring, one line per frame
+    if(argc > 1 && strcmp(argv[1], "frames")==0) {
+        cc::FrameRing ring;
+        if(!ring.attach(argc > 2 ? atoi(argv[2]) : 0)) {
+            std::cerr << "no frame ring for camera " << (argc > 2 ? argv[2] : "0") << std::endl;
+            return 1;
+        }
+        uint64_t last = 0;
+        while(true) {
+            cc::FrameView frame;
+            if(!ring.next(last, frame)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                continue;
+            }
+            uint64_t seq = frame.sequence;
+            int64_t timestamp = frame.timestamp;
+            size_t size = frame.jpegSize;
+            int width = frame.width, height = frame.height;
+            if(!ring.valid(frame)) continue;    // overwritten while we looked at it
+            std::cout << seq << " " << timestamp << " " << size << " " << width << "x" << height << (seq > last+1 && last ? " (skipped)" : "") << std::endl;
+            last = seq;
+        }
+    }
     
     cc::Logger* log = cc::Logger::getInstance();
     cc::Session* session;
+    cc::ControlServer* server = NULL;
+    cc::HttpServer* http = NULL;
+    cc::MjpegServer* mjpeg = NULL;
+    bool daemon = false;
     try {
         session = cc::Session::getInstance();
     } catch(std::runtime_error e) {
@@ -59,7 +108,30 @@ int main(int argc, char * argv[]) {
             ("l,list-devices", "List Devices", cxxopts::value<bool>())
             ("x,delete-after-download", "Delete files after download", cxxopts::value<bool>())
             ("r,default-dir", "Default directory to save to if no path is given", cxxopts::value<std::string>())
+            ("mirror", "Also write every download to these folders, comma separated. Same names as under --default-dir", cxxopts::value<std::string>())
             ("m,max-duration", "Maxium duration for video recording (in milliseconds)", cxxopts::value<int>()->default_value("-1")->implicit_value("-1"))
+            ("u,socket", "Also accept commands from any number of clients on this Unix domain socket", cxxopts::value<std::string>())
+            ("D,daemon", "Don't read stdin. Keep the session open and take commands from the socket (see \"canon-cli ctl\")", cxxopts::value<bool>())
+            ("p,http-port", "Serve a JSON control API on this localhost port", cxxopts::value<int>()->default_value("0"))
+            ("http-workers", "Number of HTTP worker threads", cxxopts::value<int>()->default_value("4"))
+            ("liveview", "Pull live view frames from the start (otherwise only while something uses them)", cxxopts::value<bool>())
+            ("liveview-fps", "Live view polling rate", cxxopts::value<double>()->default_value("15"))
+            ("shm-frames", "Publish live view frames to a shared memory ring for other processes", cxxopts::value<bool>())
+            ("shm-rgb-width", "Also publish decoded RGB frames at this width (implies --shm-frames)", cxxopts::value<int>()->default_value("0"))
+            ("motion", "Start recording on motion in live view, stop when it has been still for a while", cxxopts::value<bool>())
+            ("motion-roi", "Region watched for motion: x,y,w,h as fractions of the frame", cxxopts::value<std::string>()->default_value("0,0,1,1"))
+            ("motion-threshold", "Mean per-pixel difference that counts as motion (0-255)", cxxopts::value<double>()->default_value("8"))
+            ("motion-hold", "Seconds without motion before recording stops", cxxopts::value<double>()->default_value("5"))
+            ("exposure", "Meter exposure (histograms, clipping) on every live view frame", cxxopts::value<bool>())
+            ("focus", "Compute a focus score on every live view frame", cxxopts::value<bool>())
+            ("focus-roi", "Region the focus score looks at: x,y,w,h as fractions of the frame", cxxopts::value<std::string>()->default_value("0.25,0.25,0.5,0.5"))
+            ("proxy", "While recording, also write live view to an MJPEG AVI for quick review", cxxopts::value<bool>())
+            ("thumbnails", "Save the camera's thumbnail of each new capture next to it before the full download", cxxopts::value<bool>())
+            ("name-template", "Output file names. Fields: {dir} {serial} {name} {ext} {index} {seq} {epoch} {epoch_ms} {date} {time}, numbers take a width like {seq:06}", cxxopts::value<std::string>()->default_value(PATH_TEMPLATE_DEFAULT))
+            ("mjpeg-port", "Stream live view as MJPEG on this localhost port", cxxopts::value<int>()->default_value("0"))
+            ("fsync", "Durability of downloads: none, file (fsync each one) or group (fsync together every --fsync-interval ms)", cxxopts::value<std::string>()->default_value("none"))
+            ("fsync-interval", "How long a finished download may wait for the group fsync, in milliseconds", cxxopts::value<int>()->default_value(std::to_string(FINALIZE_GROUP_INTERVAL)))
+            ("disk-check", "When a clip might not fit on the disk: refuse to record, warn, or off", cxxopts::value<std::string>()->default_value("refuse"))
             ("help", "Print help")
             ;
         
@@ -102,16 +174,99 @@ int main(int argc, char * argv[]) {
         std::cout  << "id: " << session->cameraIndex << std::endl;
         std::cout  << "delete-after-download: " << (session->deleteAfterDownload ? "yes" : "no") << std::endl;
         std::cout  << "default-dir: " << session->defaultDir << std::endl;
+        if(options.count("mirror")) {
+            std::istringstream dirs(options["mirror"].as<std::string>());
+            for(std::string dir; std::getline(dirs, dir, ',');) {
+                while(dir.size() > 1 && dir.back() == '/') dir.pop_back();
+                if(!dir.empty()) session->mirrors.push_back(dir);
+            }
+        }
+        for(const std::string& dir : session->mirrors) {
+            std::cout  << "mirror: " << dir << std::endl;
+        }
         std::cout  << "save-to-host: " << (session->saveToHost?"yes":"no") << std::endl;
         std::cout  << "max-duration: " << session->maxDuration << std::endl;
         std::cout  << "overwrite: " << (session->overwrite ? "yes" : "no") << std::endl;
         
+        session->liveView.setFps(options["liveview-fps"].as<double>());
+        if(options["liveview"].as<bool>()) session->liveView.retain();
+        std::cout  << "liveview-fps: " << options["liveview-fps"].as<double>() << std::endl;
+        
+        session->shareFramesWidth = std::max(0, options["shm-rgb-width"].as<int>());
+        session->shareFrames = options["shm-frames"].as<bool>() || session->shareFramesWidth > 0;
+        session->motion.enabled = options["motion"].as<bool>();
+        session->motion.threshold = options["motion-threshold"].as<double>();
+        session->motion.hold = options["motion-hold"].as<double>();
+        if(!session->motion.setROI(options["motion-roi"].as<std::string>())) {
+            log->error("--motion-roi should be x,y,w,h as fractions of the frame");
+            exit(1);
+        }
+        std::cout  << "motion: " << (session->motion.enabled ? "yes" : "no") << std::endl;
+        session->exposure.enabled = options["exposure"].as<bool>();
+        std::cout  << "exposure: " << (session->exposure.enabled ? "yes" : "no") << std::endl;
+        session->focus.enabled = options["focus"].as<bool>();
+        if(!session->focus.roi.parse(options["focus-roi"].as<std::string>())) {
+            log->error("--focus-roi should be x,y,w,h as fractions of the frame");
+            exit(1);
+        }
+        std::cout  << "focus: " << (session->focus.enabled ? "yes" : "no") << std::endl;
+        try {
+            session->pathTemplate.compile(options["name-template"].as<std::string>());
+        } catch(std::runtime_error e) {
+            log->error(e.what());
+            exit(1);
+        }
+        std::cout  << "name-template: " << session->pathTemplate.source() << std::endl;
+        if(!cc::Finalizer::parsePolicy(options["fsync"].as<std::string>(), session->finalizer.policy)) {
+            log->error("--fsync should be none, file or group");
+            exit(1);
+        }
+        session->finalizer.interval = std::max(0, options["fsync-interval"].as<int>());
+        std::cout  << "fsync: " << cc::Finalizer::policyName(session->finalizer.policy) << std::endl;
+        if(!cc::DiskSpace::parsePolicy(options["disk-check"].as<std::string>(), session->disk.policy)) {
+            log->error("--disk-check should be refuse, warn or off");
+            exit(1);
+        }
+        std::cout  << "disk-check: " << cc::DiskSpace::policyName(session->disk.policy) << std::endl;
+        session->recordProxy = options["proxy"].as<bool>();
+        std::cout  << "proxy: " << (session->recordProxy ? "yes" : "no") << std::endl;
+        session->thumbnails = options["thumbnails"].as<bool>();
+        std::cout  << "thumbnails: " << (session->thumbnails ? "yes" : "no") << std::endl;
+        std::cout  << "shm-frames: " << (session->shareFrames ? cc::FrameRing::ringName(session->cameraIndex) : "no") << std::endl;
+        
+        daemon = options["daemon"].as<bool>();
+        std::cout  << "daemon: " << (daemon ? "yes" : "no") << std::endl;
+        
+        if(options.count("socket") || daemon) {
+            std::string path = options.count("socket") ? options["socket"].as<std::string>() : cc::ControlServer::defaultPath(session->cameraIndex);
+            server = new cc::ControlServer(session, path);
+            std::cout  << "socket: " << path << std::endl;
+        }
+        
+        if(options["http-port"].as<int>() > 0) {
+            http = new cc::HttpServer(session, options["http-port"].as<int>(), std::max(1, options["http-workers"].as<int>()));
+            std::cout  << "http-port: " << options["http-port"].as<int>() << std::endl;
+        }
+        
+        if(options["mjpeg-port"].as<int>() > 0) {
+            mjpeg = new cc::MjpegServer(&session->liveView, options["mjpeg-port"].as<int>());
+            std::cout  << "mjpeg-port: " << options["mjpeg-port"].as<int>() << std::endl;
+        }
         
     } catch (const cxxopts::OptionException& e) {
         log->error(e.what());
         exit(1);
     }
     
+    try {
+        if(server) server->start();
+        if(http) http->start();
+        if(mjpeg) mjpeg->start();
+    } catch(std::runtime_error e) {
+        log->error(e.what());
+        exit(1);
+    }
+    
     log->status("opening");
 
     
@@ -122,33 +277,30 @@ int main(int argc, char * argv[]) {
     //
     //  Input thread
     //
-    std::thread input([&log, &session](){
+    std::thread input;
+    if(!daemon) input = std::thread([&log, &session](){
         
         while(!sigint) {
 //            if (isatty(STDIN_FILENO)){
 //                std::cout << "> ";
 //            }
             
+            // At EOF (piped commands, or ^D) stop reading; what was sent still runs
             std::string input;
-            std::getline(std::cin, input);
+            if(!std::getline(std::cin, input)) break;
             
             if(session->downloading) {
-                log->warning("can't execute commands while downloading");
+                log->warning("can't execute commands while downloading", LOG_SITE);
             }
             
-            // Clear out any quotes. It fucks shit up.
-            input.erase( remove( input.begin(), input.end(), '\"' ), input.end() );
-            
-            
-            // Split the input string into words
-            cc::command cmd;
-            std::istringstream iss(input);
-            for(std::string s; iss >> s;) cmd.push_back(s);
+            cc::command cmd = cc::Session::parseCommand(input);
             
             
             //print_status("\""+command+"\"");
             
-            if (cmd[0].compare("exit") == 0) {
+            if (cmd.empty()) {
+                continue;
+            } else if (cmd[0].compare("exit") == 0) {
                 log->status("exit");
                 sigint = true;
             } else {
@@ -158,6 +310,19 @@ int main(int argc, char * argv[]) {
     });
     
     
+    //
+    // Set the signal handler so we can tell when to shut down gracefully.
+    // (Interactively the input thread would still be blocked on stdin.)
+    //
+    if(daemon) {
+        auto handler = [](int) {
+            sigint = true;
+        };
+        signal(SIGINT, handler);
+        signal(SIGTERM, handler);
+    }
+    
+    
     //
     //  Main camera loop
     //
@@ -166,30 +331,41 @@ int main(int argc, char * argv[]) {
         
         try {
             session->process();
-        } catch(std::runtime_error e) {
+        } catch(const std::exception& e) {
             log->error(e.what());
             exit(1);
         }
         
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        session->waitForCommands(session->idleTime()); // wakes early when a command comes in
     }
 
 
-    //
-    // Set the signal handler so we can tell when to shut down gracefully
-    //
-    signal(SIGINT, [](int signum) {
-        std::cout << "Interrupt signal (" << signum << ") received." << std::endl;
-        sigint = true;
-    });
-    
+    // Downloads waiting on a group fsync still have clients to tell
+    session->finalizer.flush();
     
     
     //
     //  Terminate SDK
     //
-    log->status("waiting for input thread");
-    input.join();
+    if(input.joinable()) {
+        log->status("waiting for input thread");
+        input.join();
+    }
+    
+    if(server) {
+        log->status("stopping control server");
+        delete server;
+    }
+    
+    if(http) {
+        log->status("stopping http server");
+        delete http;
+    }
+    
+    if(mjpeg) {
+        log->status("stopping mjpeg server");
+        delete mjpeg;
+    }
     
     
     try {
@@ -199,5 +375,6 @@ int main(int argc, char * argv[]) {
     }
     
     log->status("exiting");
+    log->flush();
     return 0;
 }